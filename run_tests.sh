@@ -0,0 +1,60 @@
+#!/bin/sh
+# Runs every input/N.txt through Main and compares what it prints with expected/N.txt,
+# byte for byte: once as is, then once more with each opt-in mode that must not change
+# the output. Also checks the statistics JSON of one run.
+#
+#     ./run_tests.sh [path to Main, default src/build/Main]
+
+MAIN=${1:-src/build/Main}
+case $MAIN in
+/*) ;;
+*) MAIN=$PWD/$MAIN ;;
+esac
+cd "$(dirname "$0")" || exit 1
+
+failed=0
+
+# check <label> [VAR=value ...]: run every input with the given environment
+check() {
+    label=$1
+    shift
+    for input in input/*.txt; do
+        name=$(basename "$input" .txt)
+        if ! env "$@" "$MAIN" "$input" 2>/dev/null | cmp -s - "expected/$name.txt"; then
+            echo "FAIL ($label): $input"
+            failed=1
+        fi
+    done
+}
+
+check "plain"
+check "scheduler" APINT_JOBS=4
+check "peephole" APINT_PEEPHOLE=1
+
+# APINT_STATS_JSON has to be valid JSON with the keys main.c documents
+if command -v python3 >/dev/null 2>&1; then
+    json=$(mktemp)
+    APINT_STATS_JSON=$json "$MAIN" input/13.txt >/dev/null 2>&1
+    if ! python3 - "$json" <<'EOF'
+import json, sys
+stats = json.load(open(sys.argv[1]))
+keys = {"count", "total_ns", "max_ns", "max_line", "operand_limbs", "max_operand_limbs",
+        "result_limbs", "max_result_limbs", "allocs", "alloc_bytes"}
+assert set(stats) == {"unit", "pool_allocs_counted", "commands"}
+assert stats["unit"] == {"time": "ns", "size": "limbs"}
+assert stats["pool_allocs_counted"] is False
+assert {"POW", "CMP", "DUMP"} <= set(stats["commands"])
+assert all(set(entry) == keys for entry in stats["commands"].values())
+assert stats["commands"]["POW"]["count"] == 2
+EOF
+    then
+        echo "FAIL (stats): APINT_STATS_JSON"
+        failed=1
+    fi
+    rm -f "$json"
+else
+    echo "skipped (stats): no python3 to read APINT_STATS_JSON"
+fi
+
+[ $failed = 0 ] && echo "all tests passed"
+exit $failed
@@ -0,0 +1,343 @@
+#include "APInt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Micro-benchmarks for the APInt library. Every result is printed as one CSV line
+ * `benchmark,limbs,ns_per_op` so runs can be diffed between versions. Operand sizes
+ * sweep by factors of four from one limb (64 bits) up to the cap given as the first
+ * argument; a second argument runs only the benchmarks whose name starts with it. */
+
+// minimum wall time spent on each measurement
+#define MIN_NS 200000000ull
+
+// default size cap, in limbs (64 Mbit)
+#define DEFAULT_MAX_LIMBS ((size_t)1 << 20)
+
+// only benchmarks whose name starts with this run
+static const char *benchFilter = "";
+
+// HELPER FUNCTIONS
+static u_int64_t nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_int64_t)ts.tv_sec * 1000000000ull + (u_int64_t)ts.tv_nsec;
+}
+
+// xorshift64; deterministic operands keep runs comparable
+static u_int64_t nextRandom(u_int64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// random APInt of exactly `limbs` limbs
+static void randomAPInt(size_t limbs, u_int64_t *state, APInt *apint)
+{
+    // 2^(64*(limbs-1)) has the right size; its limbs are then overwritten
+    APIntConvertFrom64(1, apint);
+    APIntShiftLeft(apint, APINT_LIMB_BITS * (u_int64_t)(limbs - 1), apint);
+    for (size_t i = 0; i < limbs; i++) apint->limbs[i] = nextRandom(state);
+    apint->limbs[limbs - 1] |= 1;   // keep it normalized
+}
+
+static int selected(const char *name)
+{
+    return strncmp(name, benchFilter, strlen(benchFilter)) == 0;
+}
+
+static void report(const char *name, size_t limbs, u_int64_t ns, u_int64_t reps)
+{
+    printf("%s,%zu,%llu\n", name, limbs, (unsigned long long)(ns / reps));
+    fflush(stdout);
+}
+
+// operands and destination of a benchmarked operation
+typedef struct BenchArgs {
+    const APInt *a;
+    const APInt *b;
+    APInt *result;
+    u_int64_t k;        // shift, factor or exponent
+    char *text;         // digits to parse, or room to print them
+    size_t textLen;
+} BenchArgs;
+
+typedef void (*BenchOp)(BenchArgs*);
+
+// Run `op` in doubling batches, so the clock is read rarely for quick operations, until
+// MIN_NS have passed; then report the mean time per call.
+static void benchRun(const char *name, size_t limbs, BenchOp op, BenchArgs *args)
+{
+    if (!selected(name)) return;
+
+    u_int64_t reps = 0, batch = 1, start = nowNs(), elapsed;
+    do
+    {
+        for (u_int64_t i = 0; i < batch; i++) op(args);
+        reps += batch;
+        elapsed = nowNs() - start;
+        if (elapsed < MIN_NS / 8) batch *= 2;
+    } while (elapsed < MIN_NS);
+    report(name, limbs, elapsed, reps);
+}
+
+
+// ### LINEAR OPERATIONS
+
+static void opAdd(BenchArgs *args) { APIntAdd(args->a, args->b, args->result); }
+static void opSub(BenchArgs *args) { APIntSub(args->a, args->b, args->result); }
+static void opCompare(BenchArgs *args) { (void)APIntCompare(args->a, args->b); }
+static void opShiftLeft(BenchArgs *args) { APIntShiftLeft(args->a, args->k, args->result); }
+static void opShiftRight(BenchArgs *args) { APIntShiftRight(args->a, args->k, args->result); }
+static void opMul64(BenchArgs *args) { APInt64Mult(args->a, args->k, args->result); }
+static void opClone(BenchArgs *args)
+{
+    APIntDestroy(args->result);
+    APIntClone(args->a, args->result);
+}
+
+// Time the operations linear in the operand size, all into a reused destination.
+static void benchLinear(size_t maxLimbs)
+{
+    u_int64_t state = 0x2545F4914F6CDD1Dull;
+    for (size_t limbs = 1; limbs <= maxLimbs; limbs *= 4)
+    {
+        APInt a, b, twin, result;
+        randomAPInt(limbs, &state, &a);
+        randomAPInt(limbs, &state, &b);
+        if (APIntCompare(&a, &b) < 0) APIntAddTo(&a, &b);
+        APIntInit(&result);
+
+        // a copy differing only in its lowest limb makes comparison scan everything; a
+        // shift by zero copies the limbs, which a clone would share
+        APIntInit(&twin);
+        APIntShiftLeft(&a, 0, &twin);
+        twin.limbs[0] ^= 1;
+
+        BenchArgs args = {&a, &b, &result, 0, NULL, 0};
+        benchRun("add", limbs, opAdd, &args);
+        benchRun("sub", limbs, opSub, &args);
+
+        args.b = &twin;
+        benchRun("cmp", limbs, opCompare, &args);
+
+        args.k = 37;    // not a whole number of limbs
+        benchRun("shl", limbs, opShiftLeft, &args);
+        benchRun("shr", limbs, opShiftRight, &args);
+
+        args.k = nextRandom(&state) | 1;
+        benchRun("mul64", limbs, opMul64, &args);
+        benchRun("clone", limbs, opClone, &args);
+
+        APIntDestroy(&a);
+        APIntDestroy(&b);
+        APIntDestroy(&twin);
+        APIntDestroy(&result);
+    }
+}
+
+
+// ### MULTIPLICATION
+
+static void opMult(BenchArgs *args) { APIntMult(args->a, args->b, args->result); }
+static void opSquare(BenchArgs *args) { APIntSquare(args->a, args->result); }
+static void opPow(BenchArgs *args) { APIntPow(args->a, args->k, args->result); }
+
+// exponent of the pow benchmark; the base has 1/POW_EXPONENT of the reported limbs
+#define POW_EXPONENT 8
+
+// Time products, squares and powers with the configured thresholds.
+static void benchMult(size_t maxLimbs)
+{
+    u_int64_t state = 0x9E3779B97F4A7C15ull;
+    for (size_t limbs = 1; limbs <= maxLimbs; limbs *= 4)
+    {
+        APInt a, b, result;
+        randomAPInt(limbs, &state, &a);
+        randomAPInt(limbs, &state, &b);
+        APIntInit(&result);
+
+        BenchArgs args = {&a, &b, &result, 0, NULL, 0};
+        benchRun("mul", limbs, opMult, &args);
+        benchRun("square", limbs, opSquare, &args);
+
+        // a result of about `limbs` limbs
+        if (limbs >= POW_EXPONENT)
+        {
+            APInt base;
+            randomAPInt(limbs / POW_EXPONENT, &state, &base);
+            args.a = &base;
+            args.k = POW_EXPONENT;
+            benchRun("pow", limbs, opPow, &args);
+            APIntDestroy(&base);
+        }
+
+        // a one-limb base to an exponent of all ones, as long as the result allows; the
+        // sliding window saves the most multiplications there
+        if (limbs >= 4)
+        {
+            APInt base;
+            randomAPInt(1, &state, &base);
+            args.a = &base;
+            args.k = limbs - 1;
+            benchRun("pow_ones", limbs, opPow, &args);
+            APIntDestroy(&base);
+        }
+
+        APIntDestroy(&a);
+        APIntDestroy(&b);
+        APIntDestroy(&result);
+    }
+}
+
+// Time a product with `tier` forced on from the smallest size and every tier above it
+// disabled; lower tiers keep their configured thresholds for the recursion.
+static void benchMultTier(const char *name, APIntThreshold tier, const APInt *a, const APInt *b)
+{
+    if (!selected(name)) return;
+
+    size_t saved[APINT_THRESHOLD_COUNT];
+    for (int t = 0; t < APINT_THRESHOLD_COUNT; t++) saved[t] = APIntGetThreshold((APIntThreshold)t);
+
+    APIntSetThreshold(tier, 0);
+    for (int t = tier + 1; t < APINT_THRESHOLD_COUNT; t++) APIntSetThreshold((APIntThreshold)t, (size_t)-1);
+
+    APInt product;
+    APIntInit(&product);
+    BenchArgs args = {a, b, &product, 0, NULL, 0};
+    benchRun(name, a->size, opMult, &args);
+    APIntDestroy(&product);
+
+    for (int t = 0; t < APINT_THRESHOLD_COUNT; t++) APIntSetThreshold((APIntThreshold)t, saved[t]);
+}
+
+// Toom-3 against the NTT around their crossover, for tuning APINT_NTT_THRESHOLD.
+static void benchMultTiers(size_t maxLimbs)
+{
+    u_int64_t state = 0x9E3779B97F4A7C15ull;
+    for (size_t limbs = 64; limbs <= maxLimbs; limbs *= 2)
+    {
+        APInt a, b;
+        randomAPInt(limbs, &state, &a);
+        randomAPInt(limbs, &state, &b);
+
+        benchMultTier("tier_toom3", APINT_THRESHOLD_TOOM3, &a, &b);
+        benchMultTier("tier_ntt", APINT_THRESHOLD_NTT, &a, &b);
+
+        APIntDestroy(&a);
+        APIntDestroy(&b);
+    }
+}
+
+
+// ### DIVISION
+
+static void opDivMod(BenchArgs *args) { APIntDivMod(args->a, args->b, args->result, args->result + 1); }
+
+// Time a 2n by n limb division, quotient and remainder into reused destinations.
+static void benchDiv(size_t maxLimbs)
+{
+    u_int64_t state = 0xBF58476D1CE4E5B9ull;
+    for (size_t limbs = 1; limbs <= maxLimbs; limbs *= 4)
+    {
+        APInt a, b, results[2];
+        randomAPInt(2 * limbs, &state, &a);
+        randomAPInt(limbs, &state, &b);
+        APIntInit(&results[0]);
+        APIntInit(&results[1]);
+
+        BenchArgs args = {&a, &b, results, 0, NULL, 0};
+        benchRun("divmod", limbs, opDivMod, &args);
+
+        APIntDestroy(&a);
+        APIntDestroy(&b);
+        APIntDestroy(&results[0]);
+        APIntDestroy(&results[1]);
+    }
+}
+
+
+// ### TEXT CONVERSION
+
+static void opHexParse(BenchArgs *args)
+{
+    APIntHexToAPIntN(args->text, args->textLen, args->result);
+    APIntDestroy(args->result);
+}
+
+static void opHexPrint(BenchArgs *args) { (void)APIntToHex(args->a, args->text, args->textLen); }
+
+static void opDecParse(BenchArgs *args)
+{
+    APIntFromDecimal(args->text, args->textLen, args->result);
+    APIntDestroy(args->result);
+}
+
+static void opDecPrint(BenchArgs *args) { (void)APIntToDecimal(args->a, args->text, args->textLen); }
+
+// Time parsing a fresh APInt from hex and decimal digits and printing one back into a
+// buffer.
+static void benchText(size_t maxLimbs)
+{
+    u_int64_t state = 0xD1B54A32D192ED03ull;
+    for (size_t limbs = 1; limbs <= maxLimbs; limbs *= 4)
+    {
+        APInt a, result;
+        randomAPInt(limbs, &state, &a);
+
+        size_t hexLen = APIntToHex(&a, NULL, 0);
+        char *hex = (char*)malloc(hexLen);
+        if (hex == NULL)  // error check
+        {
+            fprintf(stderr, "Error: bench failed; could not allocate sufficient memory.\n");
+            exit(1);
+        }
+        APIntToHex(&a, hex, hexLen);
+
+        BenchArgs args = {&a, NULL, &result, 0, hex, hexLen};
+        benchRun("hex_parse", limbs, opHexParse, &args);
+        benchRun("hex_print", limbs, opHexPrint, &args);
+
+        // the buffer holds the most digits, the parse gets the actual ones
+        size_t decCap = APIntToDecimal(&a, NULL, 0);
+        char *dec = (char*)malloc(decCap);
+        if (dec == NULL)  // error check
+        {
+            fprintf(stderr, "Error: bench failed; could not allocate sufficient memory.\n");
+            exit(1);
+        }
+        size_t decLen = APIntToDecimal(&a, dec, decCap);
+
+        args.text = dec;
+        args.textLen = decLen;
+        benchRun("dec_parse", limbs, opDecParse, &args);
+        args.textLen = decCap;
+        benchRun("dec_print", limbs, opDecPrint, &args);
+
+        free(dec);
+        free(hex);
+        APIntDestroy(&a);
+    }
+}
+
+
+int main(int argc, char const *argv[]) {
+    // optional arguments: the size cap in limbs and a benchmark name prefix
+    size_t maxLimbs = (argc >= 2) ? (size_t)strtoull(argv[1], NULL, 10) : DEFAULT_MAX_LIMBS;
+    if (argc >= 3) benchFilter = argv[2];
+
+    printf("benchmark,limbs,ns_per_op\n");
+    benchLinear(maxLimbs);
+    benchMult(maxLimbs);
+    benchDiv(maxLimbs);
+    benchText(maxLimbs);
+
+    // the forced tiers are only worth comparing near the NTT threshold
+    size_t tierLimbs = ((size_t)1 << 16 < maxLimbs) ? (size_t)1 << 16 : maxLimbs;
+    benchMultTiers(tierLimbs);
+    return 0;
+}
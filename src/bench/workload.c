@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+/* Generates a large macro workload for `Main` in the input/ command format:
+ *
+ *     workload <values> <bits> <commands> [seed] > workload.txt
+ *
+ * starts `values` random hex numbers of `bits` bits each, then issues `commands` random
+ * operations and a final DUMP. The generator tracks the size of every value and picks
+ * operations that keep each below 4 * `bits`, so a run stays at the chosen scale however
+ * long it is. */
+
+// HELPER FUNCTIONS
+// xorshift64; the same seed gives the same workload
+static u_int64_t nextRandom(u_int64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static u_int64_t randomBelow(u_int64_t *state, u_int64_t n)
+{
+    return nextRandom(state) % n;
+}
+
+int main(int argc, char const *argv[]) {
+    if (argc < 4)
+    {
+        fprintf(stderr, "usage: %s <values> <bits> <commands> [seed]\n", argv[0]);
+        return 1;
+    }
+    u_int64_t values = strtoull(argv[1], NULL, 10);
+    u_int64_t bits = strtoull(argv[2], NULL, 10);
+    u_int64_t commands = strtoull(argv[3], NULL, 10);
+    u_int64_t state = (argc >= 5) ? strtoull(argv[4], NULL, 10) : 1;
+    if (state == 0) state = 1;   // xorshift never leaves zero
+    if (values == 0 || values >= 10000 || bits == 0)
+    {
+        fprintf(stderr, "Error: workload failed; need 1 to 9999 values of at least one bit.\n");
+        return 1;
+    }
+
+    // approximate bits of every value, to keep products from running away
+    u_int64_t *size = (u_int64_t*)malloc(values * sizeof(u_int64_t));
+    if (size == NULL)  // error check
+    {
+        fprintf(stderr, "Error: workload failed; could not allocate sufficient memory.\n");
+        return 1;
+    }
+    u_int64_t limit = 4 * bits;
+
+    printf("%llu\n", (unsigned long long)values);
+    for (u_int64_t i = 0; i < values; i++)
+    {
+        // a leading digit of 8-f makes every value exactly `bits` bits, rounded up to a digit
+        u_int64_t digits = (bits + 3) / 4;
+        printf("HEX_STRING\n%x", (unsigned)(8 + randomBelow(&state, 8)));
+        for (u_int64_t d = 1; d < digits; d++) putchar("0123456789abcdef"[randomBelow(&state, 16)]);
+        putchar('\n');
+        size[i] = 4 * digits;
+    }
+
+    for (u_int64_t c = 0; c < commands; c++)
+    {
+        u_int64_t dst = randomBelow(&state, values);
+        u_int64_t op1 = randomBelow(&state, values);
+        u_int64_t op2 = randomBelow(&state, values);
+        u_int64_t larger = (size[op1] > size[op2]) ? size[op1] : size[op2];
+
+        // one kind of operation per draw; those that would outgrow the limit fall back to ADD
+        switch (randomBelow(&state, 6))
+        {
+        case 0:
+            if (size[op1] + size[op2] <= limit)
+            {
+                printf("MUL_APINT\n%llu %llu %llu\n", (unsigned long long)dst,
+                       (unsigned long long)op1, (unsigned long long)op2);
+                size[dst] = size[op1] + size[op2];
+                continue;
+            }
+            break;
+        case 1:
+            if (3 * size[op1] <= limit)
+            {
+                printf("POW\n%llu %llu 3\n", (unsigned long long)dst, (unsigned long long)op1);
+                size[dst] = 3 * size[op1];
+                continue;
+            }
+            break;
+        case 2:
+            if (size[op1] + 64 <= limit)
+            {
+                printf("MUL_UINT64\n%llu %llu %llu\n", (unsigned long long)dst, (unsigned long long)op1,
+                       (unsigned long long)nextRandom(&state));
+                size[dst] = size[op1] + 64;
+                continue;
+            }
+            break;
+        case 3:
+        {
+            u_int64_t k = randomBelow(&state, 1000);
+            if (size[op1] + k <= limit)
+            {
+                printf("SHL\n%llu %llu %llu\n", (unsigned long long)dst, (unsigned long long)op1,
+                       (unsigned long long)k);
+                size[dst] = size[op1] + k;
+                continue;
+            }
+            break;
+        }
+        case 4:
+            printf("CMP\n%llu %llu\n", (unsigned long long)op1, (unsigned long long)op2);
+            continue;
+        default:
+            break;
+        }
+
+        // ADD grows by a bit at most; once even that is too much, start dst over from op1
+        if (larger + 1 <= limit)
+        {
+            printf("ADD\n%llu %llu %llu\n", (unsigned long long)dst, (unsigned long long)op1,
+                   (unsigned long long)op2);
+            size[dst] = larger + 1;
+        }
+        else
+        {
+            printf("SHL\n%llu %llu 0\n", (unsigned long long)dst, (unsigned long long)op1);
+            size[dst] = size[op1];
+        }
+    }
+
+    printf("DUMP\nEND\n");
+    free(size);
+    return 0;
+}
@@ -5,16 +5,58 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+// bits held in a single limb of an APInt
+#define APINT_LIMB_BITS 64
+
+// limbs an APInt holds inline before it moves to the heap
+#define APINT_INLINE_LIMBS 2
+
+// Limbs are stored little endian (limbs[0] is least significant); `size` is the
+// number of limbs in use and `capacity` the number allocated. A normalized APInt has
+// no zero limb on top, except for the value zero itself, which is a single zero limb.
+// Values of up to APINT_INLINE_LIMBS limbs live in `inlineLimbs`, which `limbs` then
+// points into, so an APInt must be copied with APIntClone and never by assignment.
+// A capacity of 0 marks limbs borrowed from the caller (see APIntWrapLimbs). Heap limbs
+// are reference counted and shared between clones until one of them is written, so limbs
+// reached through a clone must not be written directly.
 typedef struct APInt {
-    u_int16_t size;
-    u_int8_t *bytes;
+    size_t size;
+    size_t capacity;
+    u_int64_t *limbs;
+    u_int64_t inlineLimbs[APINT_INLINE_LIMBS];
 } APInt;
 
+// Size thresholds, in limbs of the smaller factor (of the divisor for division), at which
+// the library switches to the next algorithm.
+typedef enum APIntThreshold {
+    APINT_THRESHOLD_KARATSUBA,  // schoolbook below, Karatsuba from here
+    APINT_THRESHOLD_TOOM3,      // Toom-3 from here
+    APINT_THRESHOLD_NTT,        // three-prime number theoretic transform from here
+    APINT_THRESHOLD_PARALLEL,   // NTT products spread across threads from here (see APIntSetThreads)
+    APINT_THRESHOLD_DIVIDE,     // divide and conquer division from here, schoolbook below
+    APINT_THRESHOLD_COUNT
+} APIntThreshold;
+
+// Montgomery constants for one odd modulus, filled in by APIntModInit and reused by every
+// modular operation with that modulus, from any number of threads. R is 2^(64 * size).
+typedef struct APIntModContext {
+    size_t size;            // limbs of the modulus
+    u_int64_t inverse;      // -1 / modulus mod 2^64
+    u_int64_t *modulus;
+    u_int64_t *one;         // R mod modulus
+    u_int64_t *r2;          // R^2 mod modulus
+} APIntModContext;
+
 /* You code to declare any methods you deem necessary here. */
 
 // ### CREATION AND DELETION
+// Creation methods fill in an uninitialized APInt.
+
+// Initialize APInt to zero.
+void APIntInit(APInt*);
 
-// Clones first argument into second argument.
+// Clones first argument into second argument, in constant time: the limbs are shared
+// and only copied once either APInt is written.
 void APIntClone(const APInt*, APInt*);
 
 // Free heap data of APInt pointer.
@@ -26,29 +68,111 @@ void APIntDestroy(APInt*);
 // Convert a u_int64_t into an APInt.
 void APIntConvertFrom64(u_int64_t, APInt*);
 
-// Convert an APInt into a u_int64_t.
+// Convert an APInt into a u_int64_t (least significant limb).
 u_int64_t APIntConvertTo64(APInt*);
 
 // Convert a hex string into an APInt.
 void APIntHexToAPInt(char*, APInt*);
 
+// Convert the hex digits at first argument, of length second argument, into an APInt;
+// the digits need no terminator and leading zeros are dropped.
+void APIntHexToAPIntN(const char*, size_t, APInt*);
+
+// Convert the digits at first argument, of length second argument, in the radix of third
+// argument (2 to 36, letters in either case) into an APInt; leading zeros are dropped.
+void APIntFromRadix(const char*, size_t, unsigned, APInt*);
+
+// Convert the decimal digits at first argument, of length second argument, into an APInt.
+void APIntFromDecimal(const char*, size_t, APInt*);
+
+
+// ### SERIALIZATION
+// Binary form: the limb count as a little endian u_int64_t, then the limbs, least
+// significant first, each little endian.
+
+// Write the binary form of APInt into buf if it fits in cap bytes; returns its length
+// in bytes either way.
+size_t APIntSerialize(const APInt*, void *buf, size_t cap);
+
+// Fill in an uninitialized APInt from the binary form at the start of len bytes at buf;
+// returns the bytes read, or 0 if they do not hold a whole value.
+size_t APIntDeserialize(const void *buf, size_t len, APInt*);
+
+// Fill in an uninitialized APInt using the `size` little endian limbs at `limbs` in
+// place, without copying. They are never written: the first result stored into the
+// APInt moves it to storage of its own. They must outlive the APInt, or that first store.
+void APIntWrapLimbs(const u_int64_t *limbs, size_t size, APInt*);
+
 
 // ### ARITHMETIC
+// Results are written into an initialized APInt, which grows only when it lacks the
+// capacity; it may be one of the operands.
 
 // Add APInt arguments one and two; result is placed into third argument.
 void APIntAdd(const APInt*, const APInt*, APInt*);
 
-// Multiply APInt arguments one and two; result is placed into third argument.
+// Add second argument into first argument in place.
+void APIntAddTo(APInt*, const APInt*);
+
+// Subtract APInt argument two from one, which must not be smaller; result is placed into
+// third argument.
+void APIntSub(const APInt*, const APInt*, APInt*);
+
+// Multiply APInt arguments one and two; result is placed into third argument. Passing
+// the same APInt twice squares it.
 void APIntMult(const APInt*, const APInt*, APInt*);
 
-// Multiply APInt and u_int64_t; result is placed into third argument.
+// Square APInt argument one; result is placed into second argument.
+void APIntSquare(const APInt*, APInt*);
+
+// Multiply APInt and u_int64_t in a single pass (a shift for powers of two); result is
+// placed into third argument, which may be the first.
 void APInt64Mult(const APInt*, const u_int64_t, APInt*);
 
+// Add the product of APInt arguments two and three into first argument in place, without
+// a product APInt in between; the first may also be a factor.
+void APIntAddMul(APInt*, const APInt*, const APInt*);
+
+// Add the product of APInt argument two and u_int64_t argument three into first argument
+// in place, in a single pass.
+void APIntAddMul64(APInt*, const APInt*, u_int64_t);
+
+// Add APInt argument two shifted left by third argument bits into first argument in
+// place, in a single pass.
+void APIntAddShifted(APInt*, const APInt*, u_int64_t);
+
 // Exponentiate APInt by integer argument; place result into third argument.
-void APIntPow(APInt*, u_int64_t, APInt*);
+void APIntPow(const APInt*, u_int64_t, APInt*);
+
+// Divide APInt argument one by nonzero argument two; the quotient is placed into third
+// argument and the remainder into fourth, either of which may be NULL when not wanted.
+// The two must be distinct.
+void APIntDivMod(const APInt*, const APInt*, APInt*, APInt*);
+
+
+// ### MODULAR ARITHMETIC
+// Montgomery multiplication: no operation divides by the modulus. Operands may be of
+// any size; results are reduced and written into an initialized APInt, as for
+// arithmetic.
+
+// Precompute the context for APInt modulus into second argument; returns 0, leaving it
+// unset, if the modulus is even or zero.
+int APIntModInit(const APInt*, APIntModContext*);
+
+// Free the storage of a context.
+void APIntModDestroy(APIntModContext*);
+
+// Multiply APInt arguments one and two modulo the context's modulus; result is placed
+// into fourth argument.
+void APIntModMul(const APInt*, const APInt*, const APIntModContext*, APInt*);
+
+// Raise APInt argument one to the power of APInt argument two modulo the context's
+// modulus, by sliding window exponentiation; result is placed into fourth argument.
+void APIntModPow(const APInt*, const APInt*, const APIntModContext*, APInt*);
 
 
 // ### BIT LOGIC
+// Shift results are written into an initialized APInt, as for arithmetic.
 
 // Bit shift APInt to the left once.
 void APIntLShift(APInt*);
@@ -56,13 +180,68 @@ void APIntLShift(APInt*);
 // Bit shift APInt to the right once.
 void APIntRShift(APInt*);
 
+// Shift APInt left by second argument bits; result is placed into third argument.
+void APIntShiftLeft(const APInt*, u_int64_t, APInt*);
+
+// Shift APInt right by second argument bits; result is placed into third argument.
+void APIntShiftRight(const APInt*, u_int64_t, APInt*);
+
 // Comparison of two APInts.
 int APIntCompare(const APInt*, const APInt*);
 
 
+// ### TUNING
+
+// Set a multiplication threshold at run time; values below a tier's minimum are raised to it.
+void APIntSetThreshold(APIntThreshold, size_t);
+
+// Current value of a multiplication threshold.
+size_t APIntGetThreshold(APIntThreshold);
+
+// Run NTT products, those at or above both APINT_THRESHOLD_NTT and
+// APINT_THRESHOLD_PARALLEL, on this many threads, the caller included; smaller products
+// always stay on the calling thread, so a parallel threshold below the NTT one changes
+// nothing. 1, the default, keeps everything on the calling thread. Results are the same
+// either way. Call while no product is running; with more than one thread a custom
+// allocator must be thread-safe.
+void APIntSetThreads(size_t);
+
+// Number of threads products may run on.
+size_t APIntGetThreads(void);
+
+
+// ### MEMORY
+
+// Replace the functions the library allocates with; NULL restores the C library
+// default. Old and freed sizes are passed in bytes. Call before creating any APInt.
+void APIntSetAllocator(void *(*allocFn)(size_t),
+                       void *(*reallocFn)(void*, size_t, size_t),
+                       void (*freeFn)(void*, size_t));
+
+// Return the calling thread's cached scratch memory to the allocator.
+void APIntReleaseScratch(void);
+
+
 // ### DISPLAY
 
+// Write APInt's hex digits, without prefix or terminator and padded to an even count,
+// into the buffer of second argument if they fit its capacity (third argument); returns
+// the number of digits either way.
+size_t APIntToHex(const APInt*, char*, size_t);
+
 // Print APInt as hex value to file stream of second argument.
 void APIntPrintAsHex(const APInt*, FILE*);
 
+// Write APInt's digits in the radix of second argument (2 to 36, lowercase letters),
+// without prefix or terminator, into the buffer of third argument if its capacity (fourth
+// argument) holds the most digits a value of that bit length can have; returns the number
+// of digits written, or that most if they were not.
+size_t APIntToRadix(const APInt*, unsigned, char*, size_t);
+
+// As APIntToRadix, in decimal.
+size_t APIntToDecimal(const APInt*, char*, size_t);
+
+// Print APInt as decimal value to file stream of second argument.
+void APIntPrintAsDecimal(const APInt*, FILE*);
+
 #endif
@@ -1,520 +1,649 @@
-#include "APInt.h"
+#include "APIntLimbs.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 /* Your code to define APInt here. */
 
-// maximum number of HEX integers we will fill in a u_int8_t; if u_int16_t, would be 4
-#define MAXHEXS 2
+// Heap limbs sit behind a reference count: clones share them, and the first write through
+// any of the sharers copies them out first. Counts change atomically, since values shared
+// between slots may be cloned, written and destroyed from several threads at once.
+typedef struct APIntBuffer {
+    size_t refs;
+    u_int64_t limbs[];
+} APIntBuffer;
 
-void APIntDestroy(APInt *apint)
+static size_t APIntBufferBytes(size_t capacity)
 {
-    free(apint->bytes);
+    return sizeof(APIntBuffer) + capacity * sizeof(u_int64_t);
 }
 
-void APIntPrintAsHex(const APInt *apint, FILE *stream)
+// whether apint's limbs live in its inline buffer
+static int APIntIsInline(const APInt *apint)
 {
-    u_int64_t strSize = sizeof(char) * MAXHEXS * apint->size;
-    char *decStr = (char*)malloc(strSize + 1);
-    if (decStr == NULL)  // error check
-    {
-        fprintf(stderr, "Error: Print failed; could not allocate sufficient memory.\n");
-        free(apint->bytes);
-        exit(1);
-    }
-    memset(decStr, 0, strSize + 1);     // set all zeroes and end string with null byte
+    return apint->limbs == apint->inlineLimbs;
+}
 
-    int currStrOffset = strSize-1;
-    for (u_int16_t i = 0; i < apint->size; i++)
-    {
-        u_int8_t currByte = apint->bytes[i];     // original byte
-        u_int8_t currHex = currByte % 16;        // take hex components one at a time
+// whether apint's limbs live in a heap buffer, rather than inline or borrowed
+static int APIntIsHeap(const APInt *apint)
+{
+    return !APIntIsInline(apint) && apint->capacity > 0;
+}
 
-        // fill part of `decStr` with current byte's hex equivalent
-        for (int j = 0; j < MAXHEXS; j++)
-        {
-            decStr[currStrOffset] = (currHex < 10) ? (char)(currHex + 48) : (char)(currHex + 87);
-            currStrOffset--;
+static APIntBuffer *APIntBufferOf(const APInt *apint)
+{
+    return (APIntBuffer*)((char*)apint->limbs - offsetof(APIntBuffer, limbs));
+}
 
-            currByte /= 16;
-            currHex = currByte % 16;
-        }
-    }
+// Limbs of a new heap buffer with a single reference, or NULL.
+static u_int64_t *APIntBufferNew(size_t capacity)
+{
+    APIntBuffer *buffer = (APIntBuffer*)APIntMalloc(APIntBufferBytes(capacity));
+    if (buffer == NULL) return NULL;
+    buffer->refs = 1;
+    return buffer->limbs;
+}
 
-    fprintf(stream, "0x%s\n", decStr);
-    free(decStr);
+// Drop apint's reference to its heap buffer; the last one frees it.
+static void APIntBufferRelease(APInt *apint)
+{
+    APIntBuffer *buffer = APIntBufferOf(apint);
+    if (__atomic_sub_fetch(&buffer->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        APIntFree(buffer, APIntBufferBytes(apint->capacity));
 }
 
-void APIntHexToAPInt(char *hexStr, APInt *apint)
+// whether apint's heap buffer is shared with a clone, so it must not be written
+static int APIntIsShared(const APInt *apint)
 {
-    u_int64_t hexLen = strlen(hexStr);
+    return APIntIsHeap(apint) && __atomic_load_n(&APIntBufferOf(apint)->refs, __ATOMIC_ACQUIRE) > 1;
+}
 
-    // handle hexStr of odd size
-    int overwritten = 0;
-    char *oldStr;
-    if (hexLen % 2 == 1)
+u_int64_t *APIntAllocLimbs(APInt *apint, size_t limbs)
+{
+    if (limbs <= APINT_INLINE_LIMBS)
     {
-        overwritten = 1;
-        oldStr = hexStr;
-
-        char *tempCharPtr = (char*)malloc(hexLen + 2);
-        memset(tempCharPtr, 48, hexLen + 1);    // set all values to char '0'
-        tempCharPtr[hexLen + 1] = 0;            // null terminate the string
-
-        memcpy(tempCharPtr + 1, hexStr, hexLen);
-        hexStr = tempCharPtr;
+        apint->capacity = APINT_INLINE_LIMBS;
+        apint->limbs = apint->inlineLimbs;
+    } else
+    {
+        apint->capacity = limbs;
+        apint->limbs = APIntBufferNew(limbs);
     }
+    return apint->limbs;
+}
 
-    hexLen = strlen(hexStr);
-    apint->size = (u_int16_t)(hexLen / MAXHEXS);
-    apint->bytes = (u_int8_t*)calloc(apint->size, sizeof(u_int8_t));
-    if (apint->bytes == NULL)  // error check
+// Make an initialized apint the single limb `value`; borrowed and shared limbs are let go
+// rather than written.
+static void APIntSetLimb(APInt *apint, u_int64_t value)
+{
+    if (APIntIsShared(apint))
     {
-        fprintf(stderr, "Error: Hex to number failed; could not allocate sufficient memory.\n");
-        free(apint->bytes);
-        exit(1);
+        APIntBufferRelease(apint);
+        APIntAllocLimbs(apint, 1);
     }
-
-    for (u_int16_t i = 0; i < apint->size; i++)
+    else if (apint->capacity == 0)
     {
-        // grab next two hex values (a byte worth) to place them into the APInt
-        char hexByte[3] = {hexStr[(hexLen - 1) - ((MAXHEXS*i)+1)], hexStr[(hexLen - 1) - (MAXHEXS*i)], 0};
-        u_int8_t byte = (u_int8_t)strtoul(hexByte, NULL, 16);
-
-        apint->bytes[i] = byte;
+        APIntAllocLimbs(apint, 1);
     }
+    apint->limbs[0] = value;
+    apint->size = 1;
+}
+
+void APIntInit(APInt *apint)
+{
+    // zero, held inline
+    APIntConvertFrom64(0, apint);
+}
+
+void APIntDestroy(APInt *apint)
+{
+    // borrowed limbs (capacity 0) belong to someone else
+    if (APIntIsHeap(apint)) APIntBufferRelease(apint);
+}
 
-    // free heap data if allocated and fix changed data
-    if (overwritten)
+int APIntReserve(APInt *apint, size_t limbs)
+{
+    int shared = APIntIsShared(apint);
+    if (limbs <= apint->capacity && !shared) return 1;
+
+    // grow geometrically so values built up step by step reallocate rarely
+    size_t capacity = apint->capacity;
+    if (limbs > capacity) capacity = (limbs > 2 * capacity) ? limbs : 2 * capacity;
+    u_int64_t *grown;
+    if (APIntIsInline(apint))   // first overflow moves the inline limbs to the heap
     {
-        free(hexStr);
-        hexStr = oldStr;
+        grown = APIntBufferNew(capacity);
+        if (grown != NULL) memcpy(grown, apint->inlineLimbs, sizeof(apint->inlineLimbs));
+    } else if (apint->capacity == 0 || shared)  // borrowed and shared limbs are copied out
+    {
+        if (capacity < apint->size) capacity = apint->size;
+        grown = APIntBufferNew(capacity);
+        if (grown == NULL) return 0;
+        memcpy(grown, apint->limbs, apint->size * sizeof(u_int64_t));
+        if (shared) APIntBufferRelease(apint);
+    } else
+    {
+        APIntBuffer *buffer = (APIntBuffer*)APIntRealloc(APIntBufferOf(apint), APIntBufferBytes(apint->capacity),
+                                                         APIntBufferBytes(capacity));
+        grown = (buffer != NULL) ? buffer->limbs : NULL;
     }
+    if (grown == NULL) return 0;
+
+    apint->limbs = grown;
+    apint->capacity = capacity;
+    return 1;
 }
 
 void APIntClone(const APInt *apint, APInt *apint_clone)
 {
-    // prepare apint_clone for copying
+    // heap and borrowed limbs are shared, not copied; heap ones gain a reference
     apint_clone->size = apint->size;
-    apint_clone->bytes = (u_int8_t*)calloc(apint->size, sizeof(u_int8_t));
-    if (apint_clone->bytes == NULL)  // error check
+    if (!APIntIsInline(apint))
     {
-        fprintf(stderr, "Error: Cloning failed; could not allocate sufficient memory.\n");
-        free(apint->bytes);
-        exit(1);
+        if (apint->capacity > 0) __atomic_add_fetch(&APIntBufferOf(apint)->refs, 1, __ATOMIC_RELAXED);
+        apint_clone->capacity = apint->capacity;
+        apint_clone->limbs = apint->limbs;
+        return;
     }
 
-    // copy contents of apint into apint_clone
-    memcpy(apint_clone->bytes, apint->bytes, apint->size);
+    // inline limbs are copied, which is as cheap
+    APIntAllocLimbs(apint_clone, apint->size);
+    memcpy(apint_clone->limbs, apint->limbs, apint->size * sizeof(u_int64_t));
 }
 
 u_int64_t APIntConvertTo64(APInt *apint)
 {
-    u_int64_t value64 = 0;
-
-    // copy contents of APInt over to u_int64_t
-    memcpy(&value64, apint->bytes, apint->size);
-
-    return value64;
+    // least significant limb holds the whole value of any APInt fitting a u_int64_t
+    return apint->limbs[0];
 }
 
 void APIntConvertFrom64(u_int64_t int64, APInt *apint)
 {
-    // simple u_int64_t size conversion
-    apint->size = sizeof(u_int64_t);
-    apint->bytes = (u_int8_t*)calloc(apint->size, sizeof(u_int8_t));
-    if (apint->bytes == NULL)   // error check
-    {
-        fprintf(stderr, "Error: Conversion failed; could not allocate sufficient memory.\n");
-        exit(1);
-    }
-
-    // copy contents of u_int64_t over to APInt of same size
-    memcpy(apint->bytes, &int64, apint->size);
-
-    // now empty bytes are removed from APInt to save space
-    int zeroBytes = 0;
-    for (int i = apint->size - 1; i >= 0; i--)
-    {
-        if (apint->bytes[i] == 0) zeroBytes++;
-        else break; // stop when first non-zero byte is found
-    }
-
-    // handle APInt of value zero
-    u_int16_t remainingBytes = (apint->size - zeroBytes == 0) ? 1 : (apint->size - zeroBytes);
-
-    apint->bytes = (u_int8_t*)realloc(apint->bytes, remainingBytes);
-    if (apint->bytes == NULL)   // error check
-    {
-        fprintf(stderr, "Error: Conversion failed; could not reallocate sufficient memory.\n");
-        free(apint->bytes);
-        exit(1);
-    }
-    apint->size = remainingBytes;
+    // simple u_int64_t size conversion; a u_int64_t is exactly one limb, always inline
+    apint->size = 1;
+    APIntAllocLimbs(apint, 1);
+    apint->limbs[0] = int64;
 }
 
 void APIntAdd(const APInt *apint_1, const APInt *apint_2, APInt *apint_sum)
 {
-    // new number is at least as small as biggest number; assumes zero-bytes handled
-    int option;
-    u_int8_t minLen;
-    if (apint_1->size >= apint_2->size)
+    // limb kernel expects the longer operand first
+    if (apint_1->size < apint_2->size)
     {
-        apint_sum->size = apint_1->size;
-        minLen = apint_2->size;
-        option = 1;
-    } else
-    {
-        apint_sum->size = apint_2->size;
-        minLen = apint_1->size;
-        option = 2;
+        const APInt *apint_temp = apint_1;
+        apint_1 = apint_2;
+        apint_2 = apint_temp;
     }
 
-    // allocate APInt bytes for sum
-    apint_sum->bytes = (u_int8_t*)calloc(apint_sum->size, sizeof(u_int8_t));
-    if (apint_sum->bytes == NULL)  // error check
+    // sum has room for a carry out of the longer operand; growing `apint_sum` keeps its
+    // limbs, so it may be either operand
+    size_t maxLen = apint_1->size;
+    if (!APIntReserve(apint_sum, maxLen + 1))  // error check
     {
-        fprintf(stderr, "Error: Addition failed; could not allocate sufficient memory.\n");
-        free(apint_1->bytes);
-        free(apint_2->bytes);
+        fprintf(stderr, "Error: Addition failed; could not reallocate sufficient memory.\n");
         exit(1);
     }
 
-    // main addition loop
-    int i;
-    u_int8_t carry = 0;
-    for (i = 0; i < minLen; i++)
-    {
-        u_int8_t partialSum = apint_1->bytes[i] + apint_2->bytes[i];
-        u_int8_t sum = 0;
-        if (carry)
-        {
-            sum = partialSum + carry;
-            // determine carry
-            carry = (sum <= apint_1->bytes[i] || sum <= apint_2->bytes[i]) ? 1 : 0;
-        } else
-        {
-            sum = partialSum;
-            // determine carry
-            carry = (sum < apint_1->bytes[i] || sum < apint_2->bytes[i]) ? 1 : 0;
-        }
-        apint_sum->bytes[i] = sum;
-    }
+    // main addition loop; each limb is read before the same limb of the sum is written
+    u_int64_t carry = APIntLimbsAdd(apint_sum->limbs, apint_1->limbs, maxLen, apint_2->limbs, apint_2->size);
 
-    // if necessary, continue addition with carry along larger number
-    for (;i < apint_sum->size; i++)
-    {
-        switch (option)
-        {
-        case 1: // `apint_1` is larger number
-            {
-                u_int8_t sum = apint_1->bytes[i] + carry;
-                apint_sum->bytes[i] = sum;
+    // extend by one limb if carry at final addition
+    apint_sum->limbs[maxLen] = carry;
+    apint_sum->size = maxLen + (size_t)carry;
+}
 
-                carry = (sum < apint_1->bytes[i]) ? 1 : 0;
-                break;
-            }
-        case 2: // `apint_2` is larger number
-            {
-                u_int8_t sum = apint_2->bytes[i] + carry;
-                apint_sum->bytes[i] = sum;
+void APIntAddTo(APInt *apint_acc, const APInt *apint)
+{
+    // in place, and only as far as the carry runs past `apint`
+    APIntAdd(apint_acc, apint, apint_acc);
+}
 
-                carry = (sum < apint_2->bytes[i]) ? 1 : 0;
-                break;
-            }
-        default:  // error check
-            fprintf(stderr, "Error: Addition failed; reason indeterministic.\n");
-            free(apint_1->bytes);
-            free(apint_2->bytes);
-            free(apint_sum->bytes);
-            exit(1);
-        }
+void APIntSub(const APInt *apint_1, const APInt *apint_2, APInt *apint_diff)
+{
+    // only non-negative results are representable
+    if (APIntCompare(apint_1, apint_2) < 0)
+    {
+        fprintf(stderr, "Error: Subtraction failed; second operand is larger than the first.\n");
+        exit(1);
     }
 
-    // reallocation if carry at final addition; need to extend bytes' length
-    if (carry == 1)
+    // difference never outgrows `apint_1`; growing `apint_diff` keeps its limbs, so it may
+    // be either operand
+    size_t maxLen = apint_1->size;
+    if (!APIntReserve(apint_diff, maxLen))  // error check
     {
-        apint_sum->size++;
+        fprintf(stderr, "Error: Subtraction failed; could not reallocate sufficient memory.\n");
+        exit(1);
+    }
 
-        apint_sum->bytes = (u_int8_t*)realloc(apint_sum->bytes, apint_sum->size * sizeof(u_int8_t));
-        if (apint_sum->bytes == NULL)  // error check
-        {
-            fprintf(stderr, "Error: Addition failed; could not reallocate sufficient memory.\n");
-            free(apint_1->bytes);
-            free(apint_2->bytes);
-            free(apint_sum->bytes);
-            exit(1);
-        }
+    // each limb is read before the same limb of the difference is written
+    APIntLimbsSub(apint_diff->limbs, apint_1->limbs, maxLen, apint_2->limbs, apint_2->size);
 
-        apint_sum->bytes[apint_sum->size-1] = 1;    // include carry
-    }
+    // now empty limbs are dropped; zero keeps a single limb
+    apint_diff->size = APIntSignificantLimbs(apint_diff->limbs, maxLen);
 }
 
 int APIntCompare(const APInt *apint_1, const APInt *apint_2)
 {
-    // trivial cases; assumes zero-bytes have been handled
+    // trivial cases; assumes zero-limbs have been handled
     if (apint_1->size > apint_2->size) return 1;
     else if (apint_2->size > apint_1->size) return -1;
 
-    for (int i = apint_1->size - 1; i >= 0; i--)
+    for (size_t i = apint_1->size; i-- > 0;)
     {
-        if (apint_1->bytes[i] > apint_2->bytes[i]) return 1;
-        if (apint_2->bytes[i] > apint_1->bytes[i]) return -1;
+        if (apint_1->limbs[i] > apint_2->limbs[i]) return 1;
+        if (apint_2->limbs[i] > apint_1->limbs[i]) return -1;
     }
 
     return 0;   // passing all checks implies equivalence
 }
 
-void APIntLShift(APInt *apint)
+void APIntShiftLeft(const APInt *apint, u_int64_t k, APInt *apint_shifted)
 {
-    APInt apint_temp;
-    APInt *apint_LShift = &apint_temp;
+    // zero stays a single limb however far it is shifted
+    if (apint->size == 1 && apint->limbs[0] == 0)
+    {
+        APIntSetLimb(apint_shifted, 0);
+        return;
+    }
+
+    // whole limbs move, then one pass shifts the remaining bits
+    size_t srcSize = apint->size;
+    size_t limbShift = (size_t)(k / APINT_LIMB_BITS);
+    unsigned bitShift = (unsigned)(k % APINT_LIMB_BITS);
 
-    // `apint_LShift` is at least as large as `apint`
-    apint_LShift->size = apint->size;
-    apint_LShift->bytes = (u_int8_t*)calloc(apint->size, sizeof(u_int8_t));
-    if (apint_LShift->bytes == NULL)  // error check
+    // growing `apint_shifted` keeps its limbs, so it may be `apint` itself
+    size_t shiftedSize = srcSize + limbShift + 1;
+    if (!APIntReserve(apint_shifted, shiftedSize))  // error check
     {
         fprintf(stderr, "Error: Left shift failed; could not allocate sufficient memory.\n");
-        free(apint->bytes);
         exit(1);
     }
 
-    // main LShift loop
-    u_int8_t carry = 0;
-    for (int i = 0; i < apint->size; i++)
-    {
-        u_int16_t doubleByte = (apint->bytes[i] << 1) + carry;
-        apint_LShift->bytes[i] = (u_int8_t)doubleByte;
+    // shifting walks down from the top, so the vacated low limbs are cleared last
+    u_int64_t *shiftedLimbs = apint_shifted->limbs;
+    shiftedLimbs[shiftedSize - 1] = APIntLimbsLShift(shiftedLimbs + limbShift, apint->limbs, srcSize, bitShift);
+    memset(shiftedLimbs, 0, limbShift * sizeof(u_int64_t));
 
-        // determine carry
-        u_int8_t byte = (u_int8_t)doubleByte;
-        carry = ((u_int16_t)doubleByte > (u_int16_t)byte) ? 1 : 0;
-    }
+    // top limb only holds bits when some were shifted out of the operand
+    apint_shifted->size = APIntSignificantLimbs(shiftedLimbs, shiftedSize);
+}
 
-    // reallocation if carry at final LShift; need to extend bytes' length
-    if (carry == 1)
+void APIntShiftRight(const APInt *apint, u_int64_t k, APInt *apint_shifted)
+{
+    // everything shifted out leaves zero
+    if (k / APINT_LIMB_BITS >= apint->size)
     {
-        apint_LShift->size++;
-        apint->size++;
+        APIntSetLimb(apint_shifted, 0);
+        return;
+    }
 
-        apint_LShift->bytes = (u_int8_t*)realloc(apint_LShift->bytes, apint_LShift->size * sizeof(u_int8_t));
-        if (apint_LShift->bytes == NULL)  // error check
-        {
-            fprintf(stderr, "Error: Addition failed; could not reallocate sufficient memory.\n");
-            free(apint->bytes);
-            exit(1);
-        }
+    // whole limbs drop off the bottom, then one pass shifts the remaining bits
+    size_t limbShift = (size_t)(k / APINT_LIMB_BITS);
+    unsigned bitShift = (unsigned)(k % APINT_LIMB_BITS);
 
-        apint_LShift->bytes[apint_LShift->size-1] = 1;    // include carry
+    // the result never outgrows `apint`, so an aliased destination is never reallocated
+    size_t shiftedSize = apint->size - limbShift;
+    if (!APIntReserve(apint_shifted, shiftedSize))  // error check
+    {
+        fprintf(stderr, "Error: Right shift failed; could not allocate sufficient memory.\n");
+        exit(1);
     }
 
-    // point `apint->bytes` to `apint_LShift->bytes` and free old pointer's memory
-    u_int8_t *temp = apint->bytes;
-    apint->bytes = apint_LShift->bytes;
-    free(temp);
+    // shifting walks up from the bottom, so it may run in place
+    APIntLimbsRShift(apint_shifted->limbs, apint->limbs + limbShift, shiftedSize, bitShift);
+
+    // now empty limbs are dropped; zero keeps a single limb
+    apint_shifted->size = APIntSignificantLimbs(apint_shifted->limbs, shiftedSize);
+}
+
+void APIntLShift(APInt *apint)
+{
+    APIntShiftLeft(apint, 1, apint);
 }
 
 void APIntRShift(APInt *apint)
 {
-    APInt apint_temp;
-    APInt *apint_RShift = &apint_temp;
+    APIntShiftRight(apint, 1, apint);
+}
 
-    // `apint_RShift` is at most as large as `apint`
-    apint_RShift->size = apint->size;
-    apint_RShift->bytes = (u_int8_t*)calloc(apint->size, sizeof(u_int8_t));
-    if (apint_RShift->bytes == NULL)  // error check
+// Product rp = ap[0, an) * bp[0, bn) in either order; rp needs an + bn limbs and must not
+// overlap a factor. Scratch comes from the arena. Returns the normalized size.
+static size_t APIntMultLimbs(u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn)
+{
+    // limb kernels expect the longer factor first; aliased factors take the squaring path
+    if (an < bn)
     {
-        fprintf(stderr, "Error: Right shift failed; could not allocate sufficient memory.\n");
-        free(apint->bytes);
-        exit(1);
+        const u_int64_t *tp = ap; ap = bp; bp = tp;
+        size_t tn = an; an = bn; bn = tn;
     }
 
-    // main RShift loop
-    u_int8_t carry = 0;
-    for (int i = apint->size - 1; i >= 0; i--)
+    // one scratch area serves the whole recursion of the faster tiers
+    APIntArenaMark mark = APIntArenaSave();
+    size_t scratchSize = APIntLimbsMulScratch(an, bn);
+    u_int64_t *scratch = (scratchSize > 0) ? APIntArenaAlloc(scratchSize) : NULL;
+
+    APIntLimbsMul(rp, ap, an, bp, bn, scratch);
+    APIntArenaRestore(mark);
+
+    // now empty limbs are dropped; zero keeps a single limb
+    return APIntSignificantLimbs(rp, an + bn);
+}
+
+void APIntMult(const APInt *apint_a, const APInt *apint_b, APInt *apint_product)
+{
+    // product never needs more limbs than both factors together; it cannot be computed
+    // over a factor, so a destination aliasing one is filled from a scratch copy
+    size_t prodSize = apint_a->size + apint_b->size;
+    int aliased = (apint_product->limbs == apint_a->limbs || apint_product->limbs == apint_b->limbs);
+    if (!aliased && !APIntReserve(apint_product, prodSize))  // error check
     {
-        u_int8_t byte = (apint->bytes[i] >> 1) + (u_int8_t)(carry * 128);
-        apint_RShift->bytes[i] = byte;
+        fprintf(stderr, "Error: Multiplication failed; could not allocate sufficient memory.\n");
+        exit(1);
+    }
 
-        // determine carry
-        carry = (apint->bytes[i] & (u_int8_t)1);
+    APIntArenaMark mark = APIntArenaSave();
+    u_int64_t *prodLimbs = aliased ? APIntArenaAlloc(prodSize) : apint_product->limbs;
+    size_t size = APIntMultLimbs(prodLimbs, apint_a->limbs, apint_a->size, apint_b->limbs, apint_b->size);
+
+    if (aliased)
+    {
+        if (!APIntReserve(apint_product, size))  // error check
+        {
+            fprintf(stderr, "Error: Multiplication failed; could not allocate sufficient memory.\n");
+            exit(1);
+        }
+        memcpy(apint_product->limbs, prodLimbs, size * sizeof(u_int64_t));
     }
+    apint_product->size = size;
+    APIntArenaRestore(mark);
+}
 
-    // now empty bytes are removed to save space
-    int zeroBytes = 0;
-    for (int i = apint_RShift->size - 1; i >= 0; i--)
+void APIntSquare(const APInt *apint, APInt *apint_square)
+{
+    // same limbs as both factors select the squaring kernels of every tier
+    APIntMult(apint, apint, apint_square);
+}
+
+void APInt64Mult(const APInt *apint, const u_int64_t int64, APInt *apint_product)
+{
+    // multiplying by a power of two only moves bits
+    if (int64 != 0 && (int64 & (int64 - 1)) == 0)
     {
-        if (apint_RShift->bytes[i] == 0) zeroBytes++;
-        else break; // stop when first non-zero byte is found
+        APIntShiftLeft(apint, (u_int64_t)__builtin_ctzll(int64), apint_product);
+        return;
     }
 
-    // handle APInt of value zero
-    u_int16_t remainingBytes = (apint_RShift->size - zeroBytes == 0) ? 1 : (apint_RShift->size - zeroBytes);
+    // anything times zero, or zero times anything, is a single zero limb
+    size_t srcSize = apint->size;
+    if (int64 == 0 || (srcSize == 1 && apint->limbs[0] == 0))
+    {
+        APIntSetLimb(apint_product, 0);
+        return;
+    }
 
-    apint_RShift->bytes = (u_int8_t*)realloc(apint_RShift->bytes, remainingBytes);
-    if (apint_RShift->bytes == NULL)   // error check
+    // one limb of carry at most; growing `apint_product` keeps its limbs, so it may be
+    // `apint` itself
+    if (!APIntReserve(apint_product, srcSize + 1))  // error check
     {
-        fprintf(stderr, "Error: Right shift failed; could not reallocate sufficient memory.\n");
-        free(apint->bytes);
+        fprintf(stderr, "Error: Multiplication failed; could not allocate sufficient memory.\n");
         exit(1);
     }
 
-    // point `apint->bytes` to `apint_RShift->bytes` and free old pointer's memory
-    apint->size = remainingBytes;
-    free(apint->bytes);
-    apint->bytes = apint_RShift->bytes;
+    // single pass; each limb is read before the same limb of the product is written
+    u_int64_t carry = APIntLimbsMul1(apint_product->limbs, apint->limbs, srcSize, int64);
+    apint_product->limbs[srcSize] = carry;
+    apint_product->size = srcSize + (carry != 0);
 }
 
-void APIntMult(const APInt *apint_a, const APInt *apint_b, APInt *apint_product)
+// Make apint hold `limbs` + 1 limbs for an accumulation: the limbs from its size up are
+// cleared, and the extra one on top takes the carry.
+static void APIntAccumulateReserve(APInt *apint, size_t limbs, const char *operation)
 {
-    // create copies of multiplicand and multiplier
-    APInt apint_aCpy, apint_bCpy;
-    APInt *apint_1 = &apint_aCpy;
-    APInt *apint_2 = &apint_bCpy;
-    APIntClone(apint_a, apint_1);
-    APIntClone(apint_b, apint_2);
-
-    // allocate APInt bytes for product
-    apint_product->size = 1;
-    apint_product->bytes = (u_int8_t*)calloc(apint_product->size, sizeof(u_int8_t));
-    if (apint_product->bytes == NULL)  // error check
+    if (!APIntReserve(apint, limbs + 1))  // error check
     {
-        fprintf(stderr, "Error: Multiplication failed; could not allocate sufficient memory.\n");
-        free(apint_1->bytes);
-        free(apint_2->bytes);
+        fprintf(stderr, "Error: %s failed; could not allocate sufficient memory.\n", operation);
         exit(1);
     }
-    // set product result to zero
-    memset(apint_product->bytes, 0, apint_product->size * sizeof(u_int8_t));
+    memset(apint->limbs + apint->size, 0, (limbs + 1 - apint->size) * sizeof(u_int64_t));
+}
 
-    // main multiplication loop
-    APInt apint_currSum;
-    while (!(apint_2->size == 1 && apint_2->bytes[0] == 0))
+void APIntAddMul(APInt *apint_acc, const APInt *apint_a, const APInt *apint_b)
+{
+    if (apint_a->size < apint_b->size)
     {
-        u_int8_t needAdd = (apint_2->bytes[0] & (u_int8_t)1);
+        const APInt *apint_temp = apint_a;
+        apint_a = apint_b;
+        apint_b = apint_temp;
+    }
 
-        if (needAdd)
-        {
-            // add current shift of `apint_1` into product and store as sum
-            APIntAdd(apint_1, apint_product, &apint_currSum);
+    // a zero factor adds nothing
+    size_t an = apint_a->size, bn = apint_b->size;
+    if ((bn == 1 && apint_b->limbs[0] == 0) || (an == 1 && apint_a->limbs[0] == 0)) return;
 
-            // redefine the product as the next iteration of sum
-            free(apint_product->bytes); // prep for malloc in `APIntClone`
-            APIntClone(&apint_currSum, apint_product);
+    // growing the sum keeps its limbs, so a factor it aliases still reads the same
+    size_t n = (apint_acc->size > an + bn) ? apint_acc->size : an + bn;
+    int aliased = (apint_acc->limbs == apint_a->limbs || apint_acc->limbs == apint_b->limbs);
+    APIntAccumulateReserve(apint_acc, n, "Multiply-add");
+    u_int64_t *accLimbs = apint_acc->limbs;
 
-            // reset apint_currSum; will be freed by while exit
-            free(apint_currSum.bytes);
+    if (!aliased && bn < APIntThresholds[APINT_THRESHOLD_KARATSUBA])
+    {
+        // schoolbook rows go straight into the sum, each carrying into the limbs above it
+        for (size_t j = 0; j < bn; j++)
+        {
+            u_int64_t carry = APIntLimbsAddMul1(accLimbs + j, apint_a->limbs, an, apint_b->limbs[j]);
+            APIntLimbsAdd(accLimbs + j + an, accLimbs + j + an, n + 1 - j - an, &carry, 1);
         }
-
-        // Left shift apint_1 and Right shift apint_2
-        APIntLShift(apint_1);
-        APIntRShift(apint_2);
     }
+    else
+    {
+        // the faster tiers need the product on its own, in scratch, added in one pass
+        APIntArenaMark mark = APIntArenaSave();
+        u_int64_t *prodLimbs = APIntArenaAlloc(an + bn);
+        size_t prodSize = APIntMultLimbs(prodLimbs, apint_a->limbs, an, apint_b->limbs, bn);
+        APIntLimbsAdd(accLimbs, accLimbs, n + 1, prodLimbs, prodSize);
+        APIntArenaRestore(mark);
+    }
+    apint_acc->size = APIntSignificantLimbs(accLimbs, n + 1);
+}
 
-    // now empty bytes are removed to save space
-    int zeroBytes = 0;
-    for (int i = apint_product->size - 1; i >= 0; i--)
+void APIntAddMul64(APInt *apint_acc, const APInt *apint, u_int64_t int64)
+{
+    // adding to itself is a plain multiple: by int64 + 1, or 2^64 when that wraps
+    if (apint_acc->limbs == apint->limbs)
     {
-        if (apint_product->bytes[i] == 0) zeroBytes++;
-        else break; // stop when first non-zero byte is found
+        if (int64 + 1 != 0)
+            APInt64Mult(apint_acc, int64 + 1, apint_acc);
+        else
+            APIntShiftLeft(apint_acc, APINT_LIMB_BITS, apint_acc);
+        return;
     }
 
-    // handle APInt of value zero
-    u_int16_t remainingBytes = (apint_product->size - zeroBytes == 0) ? 1 : (apint_product->size - zeroBytes);
+    size_t srcSize = apint->size;
+    if (int64 == 0 || (srcSize == 1 && apint->limbs[0] == 0)) return;
+
+    // single pass over `apint`, then the carry runs on into the sum
+    size_t n = (apint_acc->size > srcSize) ? apint_acc->size : srcSize;
+    APIntAccumulateReserve(apint_acc, n, "Multiply-add");
+    u_int64_t *accLimbs = apint_acc->limbs;
+    u_int64_t carry = APIntLimbsAddMul1(accLimbs, apint->limbs, srcSize, int64);
+    APIntLimbsAdd(accLimbs + srcSize, accLimbs + srcSize, n + 1 - srcSize, &carry, 1);
+    apint_acc->size = APIntSignificantLimbs(accLimbs, n + 1);
+}
+
+void APIntAddShifted(APInt *apint_acc, const APInt *apint, u_int64_t k)
+{
+    size_t srcSize = apint->size;
+    if (srcSize == 1 && apint->limbs[0] == 0) return;
 
-    apint_product->bytes = (u_int8_t*)realloc(apint_product->bytes, remainingBytes);
-    if (apint_product->bytes == NULL)   // error check
+    // adding to itself needs the unshifted value kept aside
+    APIntArenaMark mark = APIntArenaSave();
+    const u_int64_t *srcLimbs = apint->limbs;
+    if (apint_acc->limbs == srcLimbs)
     {
-        fprintf(stderr, "Error: Multiplication failed; could not reallocate sufficient memory.\n");
-        free(apint_1->bytes);
-        free(apint_2->bytes);
-        free(apint_product->bytes);
-        exit(1);
+        u_int64_t *copy = APIntArenaAlloc(srcSize);
+        memcpy(copy, srcLimbs, srcSize * sizeof(u_int64_t));
+        srcLimbs = copy;
     }
-    apint_product->size = remainingBytes;
 
-    // cleanup temporary data
-    APIntDestroy(apint_1);
-    APIntDestroy(apint_2);
+    // whole limbs only offset where the single shifting pass starts adding
+    size_t limbShift = (size_t)(k / APINT_LIMB_BITS);
+    unsigned bitShift = (unsigned)(k % APINT_LIMB_BITS);
+    size_t top = limbShift + srcSize;
+    size_t n = (apint_acc->size > top) ? apint_acc->size : top;
+    APIntAccumulateReserve(apint_acc, n, "Shifted addition");
+    u_int64_t *accLimbs = apint_acc->limbs;
+    u_int64_t carry = APIntLimbsAddLShift(accLimbs + limbShift, srcLimbs, srcSize, bitShift);
+    APIntLimbsAdd(accLimbs + top, accLimbs + top, n + 1 - top, &carry, 1);
+    apint_acc->size = APIntSignificantLimbs(accLimbs, n + 1);
+    APIntArenaRestore(mark);
 }
 
-void APInt64Mult(const APInt *apint, const u_int64_t int64, APInt *apint_product)
-{
-    // create an APInt from int64
-    APInt apint_from64;
-    APIntConvertFrom64(int64, &apint_from64);
-    
-    // use `APIntMult` to achieve product
-    APIntMult(apint, &apint_from64, apint_product);
+// widest sliding window APIntPow uses; its table holds 2^(k-1) odd powers
+#define APINT_POW_MAX_WINDOW 5
 
-    // cleanup
-    APIntDestroy(&apint_from64);
+// Window width for an exponent of `bits` bits: a wider window multiplies less often,
+// but each extra bit doubles the table.
+static unsigned APIntPowWindow(unsigned bits)
+{
+    if (bits <= 4) return 1;
+    if (bits <= 12) return 2;
+    if (bits <= 24) return 3;
+    if (bits <= 48) return 4;
+    return APINT_POW_MAX_WINDOW;
 }
 
-void APIntPow(APInt *apint, u_int64_t exponent, APInt *apint_product)
+// a^e for a = ap[0, an) and e >= 1, scanning e from the top with a sliding window over
+// the odd powers a, a^3, ..., a^(2^k - 1). Any a^m with m <= e fits in `bound` limbs.
+// Buffers come from the arena, which the caller restores; returns the limbs of the
+// result and sets *size.
+static u_int64_t *APIntPowLimbs(const u_int64_t *ap, size_t an, u_int64_t e, size_t bound, size_t *size)
 {
-    // handle power 0
-    if (exponent == 0)
+    int ebits = APINT_LIMB_BITS - __builtin_clzll(e);
+    int k = (int)APIntPowWindow((unsigned)ebits);
+
+    // table[j] = a^(2j + 1), each built from the one before and a^2
+    const u_int64_t *table[1 << (APINT_POW_MAX_WINDOW - 1)];
+    size_t tableSize[1 << (APINT_POW_MAX_WINDOW - 1)];
+    table[0] = ap;
+    tableSize[0] = an;
+    if (k > 1)
     {
-        apint_product->size = 1;
-        apint_product->bytes = (u_int8_t*)malloc(sizeof(u_int8_t));
-        if (apint_product->bytes == NULL)   // error check
+        u_int64_t *square = APIntArenaAlloc(2 * an);
+        size_t squareSize = APIntMultLimbs(square, ap, an, ap, an);
+        for (int j = 1; j < (1 << (k - 1)); j++)
         {
-            fprintf(stderr, "Error: Power failed; could not allocate sufficient memory.\n");
-            free(apint->bytes);
-            exit(1);
+            u_int64_t *entry = APIntArenaAlloc(tableSize[j - 1] + squareSize);
+            tableSize[j] = APIntMultLimbs(entry, table[j - 1], tableSize[j - 1], square, squareSize);
+            table[j] = entry;
         }
-        apint_product->bytes[0] = 1;
-        return;
     }
 
-    // create intermediate result apint
-    APInt apint_interRes;
-    apint_interRes.size = 1;
-    apint_interRes.bytes = (u_int8_t*)malloc(sizeof(u_int8_t));
-    if (apint_interRes.bytes == NULL)   // error check
-    {
-        fprintf(stderr, "Error: Power failed; could not allocate sufficient memory.\n");
-        free(apint->bytes);
-        exit(1);
-    }
-    apint_interRes.bytes[0] = 1;
+    // each product lands in `temp` and swaps places with the value it replaces
+    u_int64_t *result = APIntArenaAlloc(bound);
+    u_int64_t *temp = APIntArenaAlloc(bound);
+    u_int64_t *swap;
+    size_t resultSize = 0;
 
-    // main power loop; treating this as pow(x, n) with exponentiation by squaring
-    APInt apint_x;
-    APIntClone(apint, &apint_x);
-    u_int64_t n = exponent;
-    while (n >= 1)
+    int i = ebits - 1;
+    while (i >= 0)
     {
-        APInt result, apint_xCpy1, apint_xCpy2;
-        if (n % 2 == 1)     // if n is odd
+        // zero bits between windows are a squaring each
+        if (((e >> i) & 1) == 0)
         {
-            // result = result * x;
-            APIntMult(&apint_interRes, &apint_x, &result);
-            free(apint_interRes.bytes);
-            APIntClone(&result, &apint_interRes);
-            // cleanup
-            APIntDestroy(&result);
+            resultSize = APIntMultLimbs(temp, result, resultSize, result, resultSize);
+            swap = result; result = temp; temp = swap;
+            i--;
+            continue;
         }
 
-        // x = x * x;
-        APIntClone(&apint_x, &apint_xCpy1);
-        APIntClone(&apint_x, &apint_xCpy2);
-        free(apint_x.bytes);
-        APIntMult(&apint_xCpy1, &apint_xCpy2, &apint_x);
+        // the widest window of at most k bits down from bit i that ends in a one
+        int j = (i - k + 1 > 0) ? i - k + 1 : 0;
+        while (((e >> j) & 1) == 0) j++;
+        size_t entry = (size_t)(((e >> j) & ((2ull << (i - j)) - 1)) >> 1);
 
-        n = n / 2;
+        // the top window starts the result; later ones shift it up and multiply in
+        if (resultSize == 0)
+        {
+            memcpy(result, table[entry], tableSize[entry] * sizeof(u_int64_t));
+            resultSize = tableSize[entry];
+        }
+        else
+        {
+            for (int s = j; s <= i; s++)
+            {
+                resultSize = APIntMultLimbs(temp, result, resultSize, result, resultSize);
+                swap = result; result = temp; temp = swap;
+            }
+            resultSize = APIntMultLimbs(temp, result, resultSize, table[entry], tableSize[entry]);
+            swap = result; result = temp; temp = swap;
+        }
+        i = j - 1;
+    }
+
+    *size = resultSize;
+    return result;
+}
 
-        // cleanup
-        APIntDestroy(&apint_xCpy1);
-        APIntDestroy(&apint_xCpy2);
+void APIntPow(const APInt *apint, u_int64_t exponent, APInt *apint_product)
+{
+    // handle power 0; zero and one are every power of themselves
+    if (exponent == 0)
+    {
+        APIntSetLimb(apint_product, 1);
+        return;
+    }
+    if (apint->size == 1 && apint->limbs[0] <= 1)
+    {
+        APIntSetLimb(apint_product, apint->limbs[0]);
+        return;
     }
-    APIntClone(&apint_interRes, apint_product);
 
+    // a = b * 2^t with b odd, so a^e = b^e * 2^(t*e): the factors of two become one
+    // shift at the end, and a power of two needs no multiplication at all
+    size_t zeroLimbs = 0;
+    while (apint->limbs[zeroLimbs] == 0) zeroLimbs++;
+    u_int64_t trailing = APINT_LIMB_BITS * (u_int64_t)zeroLimbs + (u_int64_t)__builtin_ctzll(apint->limbs[zeroLimbs]);
+
+    // b^m has at most m times the bits of b, and every product below is b^m with
+    // m <= exponent, so one bound sizes all intermediates up front
+    u_int64_t topLimb = apint->limbs[apint->size - 1];
+    u_int64_t bits = APINT_LIMB_BITS * (u_int64_t)(apint->size - 1);
+    while (topLimb != 0) { bits++; topLimb >>= 1; }
+    if (exponent > (u_int64_t)(SIZE_MAX / sizeof(u_int64_t)) / bits)  // error check
+    {
+        fprintf(stderr, "Error: Power failed; result too large.\n");
+        exit(1);
+    }
+    size_t bound = (size_t)((bits - trailing) * exponent / APINT_LIMB_BITS) + 2;
+
+    APIntArenaMark mark = APIntArenaSave();
+    size_t oddSize = apint->size - zeroLimbs;
+    u_int64_t *odd = APIntArenaAlloc(oddSize);
+    APIntLimbsRShift(odd, apint->limbs + zeroLimbs, oddSize, (unsigned)(trailing % APINT_LIMB_BITS));
+    oddSize = APIntSignificantLimbs(odd, oddSize);
+
+    size_t powSize = 1;
+    u_int64_t *pow = odd;
+    if (oddSize > 1 || odd[0] != 1) pow = APIntPowLimbs(odd, oddSize, exponent, bound, &powSize);
+
+    // the result is sized once, exactly, and the shift writes it in place; a destination
+    // aliasing `apint` is fine, as the base is no longer read
+    u_int64_t shift = trailing * exponent;
+    size_t limbShift = (size_t)(shift / APINT_LIMB_BITS);
+    size_t size = powSize + limbShift + 1;
+    if (!APIntReserve(apint_product, size))  // error check
+    {
+        fprintf(stderr, "Error: Power failed; could not allocate sufficient memory.\n");
+        exit(1);
+    }
+    u_int64_t *limbs = apint_product->limbs;
+    limbs[size - 1] = APIntLimbsLShift(limbs + limbShift, pow, powSize, (unsigned)(shift % APINT_LIMB_BITS));
+    memset(limbs, 0, limbShift * sizeof(u_int64_t));
+    apint_product->size = APIntSignificantLimbs(limbs, size);
 
-    // cleanup
-    APIntDestroy(&apint_interRes);
-    APIntDestroy(&apint_x);
+    // all intermediates go back to the arena at once
+    APIntArenaRestore(mark);
 }
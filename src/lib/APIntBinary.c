@@ -0,0 +1,80 @@
+#include "APIntLimbs.h"
+#include <string.h>
+
+/* Binary form of an APInt: the limb count as a little endian u_int64_t, then the limbs,
+ * least significant first, each little endian. On little endian hosts that is the
+ * in-memory layout, so limbs can be used where they lie (APIntWrapLimbs). */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define APINT_BINARY_SWAP 1
+#endif
+
+// bytes of the limb count in front of the limbs
+#define APINT_BINARY_HEADER sizeof(u_int64_t)
+
+// Copy n little endian limbs between byte buffers and limb arrays.
+static void APIntBinaryCopy(void *dst, const void *src, size_t n)
+{
+#ifdef APINT_BINARY_SWAP
+    const unsigned char *from = (const unsigned char*)src;
+    unsigned char *to = (unsigned char*)dst;
+    for (size_t i = 0; i < n; i++)
+    {
+        u_int64_t limb;
+        memcpy(&limb, from + i * sizeof(u_int64_t), sizeof(u_int64_t));
+        limb = __builtin_bswap64(limb);
+        memcpy(to + i * sizeof(u_int64_t), &limb, sizeof(u_int64_t));
+    }
+#else
+    memcpy(dst, src, n * sizeof(u_int64_t));
+#endif
+}
+
+size_t APIntSerialize(const APInt *apint, void *buf, size_t cap)
+{
+    size_t length = APINT_BINARY_HEADER + apint->size * sizeof(u_int64_t);
+    if (length > cap) return length;
+
+    u_int64_t count = apint->size;
+    APIntBinaryCopy(buf, &count, 1);
+    APIntBinaryCopy((unsigned char*)buf + APINT_BINARY_HEADER, apint->limbs, apint->size);
+    return length;
+}
+
+size_t APIntDeserialize(const void *buf, size_t len, APInt *apint)
+{
+    // the count has to fit, and so do the limbs it announces
+    u_int64_t count;
+    if (len < APINT_BINARY_HEADER) return 0;
+    APIntBinaryCopy(&count, buf, 1);
+    if (count > (len - APINT_BINARY_HEADER) / sizeof(u_int64_t)) return 0;
+
+    // an empty value is zero; zero limbs on top are dropped
+    const unsigned char *limbs = (const unsigned char*)buf + APINT_BINARY_HEADER;
+    size_t size = (count == 0) ? 1 : (size_t)count;
+    if (APIntAllocLimbs(apint, size) == NULL)  // error check
+    {
+        fprintf(stderr, "Error: Deserialization failed; could not allocate sufficient memory.\n");
+        exit(1);
+    }
+    apint->limbs[0] = 0;
+    APIntBinaryCopy(apint->limbs, limbs, (size_t)count);
+    apint->size = APIntSignificantLimbs(apint->limbs, size);
+
+    return APINT_BINARY_HEADER + (size_t)count * sizeof(u_int64_t);
+}
+
+void APIntWrapLimbs(const u_int64_t *limbs, size_t size, APInt *apint)
+{
+    size = (size == 0) ? 0 : APIntSignificantLimbs(limbs, size);
+    if (size == 0 || (size == 1 && limbs[0] == 0))
+    {
+        APIntConvertFrom64(0, apint);
+        return;
+    }
+
+    // capacity 0 marks the limbs as borrowed: never written, grown or freed
+    apint->size = size;
+    apint->capacity = 0;
+    apint->limbs = (u_int64_t*)limbs;
+}
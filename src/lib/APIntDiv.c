@@ -0,0 +1,270 @@
+#include "APIntLimbs.h"
+#include <string.h>
+
+/* Division. Divisors are first shifted so their top bit is set, which lets a quotient
+ * limb be estimated from the top limbs alone. Single limbs divide with a precomputed
+ * reciprocal instead of a hardware division (Moller and Granlund). Longer divisors use
+ * Knuth's Algorithm D, and from APINT_THRESHOLD_DIVIDE limbs on, Burnikel and Ziegler's
+ * divide and conquer: half the quotient comes from the top halves of the operands, and
+ * the error of ignoring the rest is one product, taken by the fast multipliers. */
+
+
+// ### SINGLE LIMB
+
+// floor((B^2 - 1) / d) - B for a normalized d, the reciprocal the 2-by-1 step uses
+static u_int64_t APIntDivInvert(u_int64_t d)
+{
+    return (u_int64_t)((((u_int128_t)~d << APINT_LIMB_BITS) | ~(u_int64_t)0) / d);
+}
+
+// Quotient of <u1, u0> by a normalized d with reciprocal v, for u1 < d; sets *r to the
+// remainder.
+static inline u_int64_t APIntDiv2by1(u_int64_t *r, u_int64_t u1, u_int64_t u0, u_int64_t d, u_int64_t v)
+{
+    u_int128_t q = (u_int128_t)v * u1 + (((u_int128_t)u1 << APINT_LIMB_BITS) | u0);
+    u_int64_t q1 = (u_int64_t)(q >> APINT_LIMB_BITS) + 1;
+    u_int64_t q0 = (u_int64_t)q;
+
+    // the estimate is at most one off either way
+    u_int64_t rem = u0 - q1 * d;
+    if (rem > q0)
+    {
+        q1--;
+        rem += d;
+    }
+    if (rem >= d)
+    {
+        q1++;
+        rem -= d;
+    }
+    *r = rem;
+    return q1;
+}
+
+u_int64_t APIntLimbsDivRem1(u_int64_t *qp, const u_int64_t *ap, size_t n, u_int64_t d)
+{
+    // the numerator is shifted along with d as it is read, never stored shifted
+    unsigned shift = (unsigned)__builtin_clzll(d);
+    d <<= shift;
+    u_int64_t v = APIntDivInvert(d);
+
+    u_int64_t r = 0;
+    if (shift == 0)
+    {
+        for (size_t i = n; i-- > 0;) qp[i] = APIntDiv2by1(&r, r, ap[i], d, v);
+        return r;
+    }
+
+    r = ap[n - 1] >> (APINT_LIMB_BITS - shift);
+    for (size_t i = n - 1; i > 0; i--)
+    {
+        u_int64_t u = (ap[i] << shift) | (ap[i - 1] >> (APINT_LIMB_BITS - shift));
+        qp[i] = APIntDiv2by1(&r, r, u, d, v);
+    }
+    qp[0] = APIntDiv2by1(&r, r, ap[0] << shift, d, v);
+    return r >> shift;
+}
+
+
+// ### SCHOOLBOOK
+
+// Knuth's Algorithm D: qp[0, nn - dn) = np[0, nn) / dp[0, dn) for a normalized divisor
+// of dn >= 2 limbs whose top limb has reciprocal v. The remainder replaces np[0, dn).
+// Returns the quotient limb above qp, 0 or 1.
+static u_int64_t APIntDivBasecase(u_int64_t *qp, u_int64_t *np, size_t nn, const u_int64_t *dp, size_t dn,
+                                  u_int64_t v)
+{
+    // the top dn limbs hold the divisor once at most
+    u_int64_t qh = (APIntLimbsCmp(np + nn - dn, dn, dp, dn) >= 0);
+    if (qh) APIntLimbsSubN(np + nn - dn, np + nn - dn, dp, dn);
+
+    u_int64_t d1 = dp[dn - 1], d0 = dp[dn - 2];
+    for (size_t j = nn - dn; j-- > 0;)
+    {
+        // estimate from the top two limbs, refined with the third; the partial remainder
+        // is below the divisor, so n2 <= d1
+        u_int64_t n2 = np[j + dn], n1 = np[j + dn - 1], n0 = np[j + dn - 2];
+        u_int64_t q, r;
+        int refine = 1;
+        if (n2 == d1)
+        {
+            q = ~(u_int64_t)0;
+            r = n1 + d1;
+            refine = (r >= d1);     // a remainder past B cannot fail the test
+        }
+        else
+        {
+            q = APIntDiv2by1(&r, n2, n1, d1, v);
+        }
+        while (refine && (u_int128_t)q * d0 > (((u_int128_t)r << APINT_LIMB_BITS) | n0))
+        {
+            q--;
+            r += d1;
+            refine = (r >= d1);
+        }
+
+        // now one too large at most, which shows as a borrow out of the top limb
+        u_int64_t borrow = APIntLimbsSubMul1(np + j, dp, dn, q);
+        if (borrow > n2)
+        {
+            q--;
+            APIntLimbsAddN(np + j, np + j, dp, dn);
+        }
+        qp[j] = q;
+    }
+    return qh;
+}
+
+
+// ### DIVIDE AND CONQUER
+
+// Product rp[0, an + bn) = ap[0, an) * bp[0, bn) in either order, scratch from the arena.
+static void APIntDivMul(u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn)
+{
+    if (an < bn)
+    {
+        const u_int64_t *tp = ap; ap = bp; bp = tp;
+        size_t tn = an; an = bn; bn = tn;
+    }
+    APIntArenaMark mark = APIntArenaSave();
+    size_t scratchSize = APIntLimbsMulScratch(an, bn);
+    APIntLimbsMul(rp, ap, an, bp, bn, (scratchSize > 0) ? APIntArenaAlloc(scratchSize) : NULL);
+    APIntArenaRestore(mark);
+}
+
+static u_int64_t APIntDivBlock(u_int64_t *qp, u_int64_t *np, size_t qn, const u_int64_t *dp, size_t dn,
+                               u_int64_t v);
+
+// qp[0, n) = np[0, 2n) / dp[0, n), remainder into np[0, n), by dividing twice: the top
+// half of the quotient, then the bottom. Returns the quotient limb above qp.
+static u_int64_t APIntDivRecursive(u_int64_t *qp, u_int64_t *np, const u_int64_t *dp, size_t n, u_int64_t v)
+{
+    size_t lo = n / 2, hi = n - lo;
+    u_int64_t qh = APIntDivBlock(qp + lo, np + lo, hi, dp, n, v);
+    APIntDivBlock(qp, np, lo, dp, n, v);
+    return qh;
+}
+
+// qp[0, qn) = np[0, dn + qn) / dp[0, dn) for qn <= dn, remainder into np[0, dn); returns
+// the quotient limb above qp. Dividing the top 2qn limbs by the top qn of the divisor
+// estimates the quotient; subtracting its product with the low dn - qn divisor limbs
+// corrects the remainder, and the quotient is then at most a few too large.
+static u_int64_t APIntDivBlock(u_int64_t *qp, u_int64_t *np, size_t qn, const u_int64_t *dp, size_t dn,
+                               u_int64_t v)
+{
+    if (qn < APIntThresholds[APINT_THRESHOLD_DIVIDE]) return APIntDivBasecase(qp, np, dn + qn, dp, dn, v);
+
+    u_int64_t qh = APIntDivRecursive(qp, np + dn - qn, dp + dn - qn, qn, v);
+    if (qn == dn) return qh;
+
+    APIntArenaMark mark = APIntArenaSave();
+    u_int64_t *tp = APIntArenaAlloc(dn);
+    APIntDivMul(tp, qp, qn, dp, dn - qn);
+    u_int64_t borrow = APIntLimbsSubN(np, np, tp, dn);
+    if (qh) borrow += APIntLimbsSubN(np + qn, np + qn, dp, dn - qn);
+    APIntArenaRestore(mark);
+
+    // each step back takes one from the quotient and adds the divisor to a negative
+    // remainder
+    while (borrow)
+    {
+        size_t i = 0;
+        while (i < qn && qp[i] == 0) qp[i++] = ~(u_int64_t)0;
+        if (i < qn)
+            qp[i]--;
+        else
+            qh--;
+        borrow -= APIntLimbsAddN(np, np, dp, dn);
+    }
+    return qh;
+}
+
+
+// ### DRIVER
+
+void APIntLimbsDivRem(u_int64_t *qp, u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *dp,
+                      size_t dn)
+{
+    if (dn == 1)
+    {
+        rp[0] = APIntLimbsDivRem1(qp, ap, an, dp[0]);
+        return;
+    }
+
+    // shift both so the divisor's top bit is set; the numerator gains a limb, which keeps
+    // its top dn limbs below the divisor
+    APIntArenaMark mark = APIntArenaSave();
+    unsigned shift = (unsigned)__builtin_clzll(dp[dn - 1]);
+    u_int64_t *d = APIntArenaAlloc(dn);
+    u_int64_t *np = APIntArenaAlloc(an + 1);
+    APIntLimbsLShift(d, dp, dn, shift);
+    np[an] = APIntLimbsLShift(np, ap, an, shift);
+    u_int64_t v = APIntDivInvert(d[dn - 1]);
+
+    // a short divisor goes through the schoolbook loop in one pass; a long one in blocks
+    // of dn quotient limbs from the top, the odd-sized block first
+    size_t qn = an + 1 - dn;
+    if (dn < APIntThresholds[APINT_THRESHOLD_DIVIDE])
+    {
+        APIntDivBasecase(qp, np, an + 1, d, dn, v);
+    }
+    else
+    {
+        size_t first = (qn % dn == 0) ? dn : qn % dn;
+        size_t offset = qn - first;
+        APIntDivBlock(qp + offset, np + offset, first, d, dn, v);
+        while (offset > 0)
+        {
+            offset -= dn;
+            APIntDivBlock(qp + offset, np + offset, dn, d, dn, v);
+        }
+    }
+
+    APIntLimbsRShift(rp, np, dn, shift);
+    APIntArenaRestore(mark);
+}
+
+
+// ### DIVISION
+
+// Store the n limbs at xp into an initialized apint.
+static void APIntDivStore(const u_int64_t *xp, size_t n, APInt *apint)
+{
+    if (!APIntReserve(apint, n))  // error check
+    {
+        fprintf(stderr, "Error: Division failed; could not allocate sufficient memory.\n");
+        exit(1);
+    }
+    memmove(apint->limbs, xp, n * sizeof(u_int64_t));
+    apint->size = APIntSignificantLimbs(apint->limbs, n);
+}
+
+void APIntDivMod(const APInt *apint_a, const APInt *apint_b, APInt *apint_q, APInt *apint_r)
+{
+    if (apint_b->size == 1 && apint_b->limbs[0] == 0)  // error check
+    {
+        fprintf(stderr, "Error: Division failed; division by zero.\n");
+        exit(1);
+    }
+
+    // a smaller dividend is the remainder itself
+    size_t an = apint_a->size, bn = apint_b->size;
+    if (APIntLimbsCmp(apint_a->limbs, an, apint_b->limbs, bn) < 0)
+    {
+        u_int64_t zero = 0;
+        if (apint_r != NULL) APIntDivStore(apint_a->limbs, an, apint_r);
+        if (apint_q != NULL) APIntDivStore(&zero, 1, apint_q);
+        return;
+    }
+
+    // both land in the arena first, so either may be an operand
+    APIntArenaMark mark = APIntArenaSave();
+    size_t qn = an - bn + 1;
+    u_int64_t *qp = APIntArenaAlloc(qn);
+    u_int64_t *rp = APIntArenaAlloc(bn);
+    APIntLimbsDivRem(qp, rp, apint_a->limbs, an, apint_b->limbs, bn);
+
+    if (apint_r != NULL) APIntDivStore(rp, bn, apint_r);
+    if (apint_q != NULL) APIntDivStore(qp, qn, apint_q);
+    APIntArenaRestore(mark);
+}
@@ -0,0 +1,264 @@
+#include "APIntLimbs.h"
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define APINT_HEX_X86 1
+#endif
+
+/* Hex conversion. Digits are decoded without branches: for any of 0-9, a-f and A-F,
+ * (c & 0xf) + 9 * (c >> 6) is the digit's value. Sixteen digits make one limb; on x86-64
+ * the decoder picks AVX2 (two limbs per step) or SSSE3 (one limb) at run time and falls
+ * back to scalar code elsewhere. Encoding looks digits up by the byte, or sixteen at a
+ * time with SSSE3 shuffles. */
+
+// hex digits per limb
+#define APINT_HEX_PER_LIMB 16
+
+
+// ### DECODING
+
+// value of the sixteen hex digits at p, most significant first
+static u_int64_t APIntHexDecodeLimb(const char *p)
+{
+    u_int64_t limb = 0;
+    for (int k = 0; k < APINT_HEX_PER_LIMB; k++)
+    {
+        u_int8_t c = (u_int8_t)p[k];
+        limb = (limb << 4) | (u_int64_t)((c & 0xf) + 9 * (c >> 6));
+    }
+    return limb;
+}
+
+// value of the n <= 16 hex digits at p
+static u_int64_t APIntHexDecodePartial(const char *p, size_t n)
+{
+    u_int64_t limb = 0;
+    for (size_t k = 0; k < n; k++)
+    {
+        u_int8_t c = (u_int8_t)p[k];
+        limb = (limb << 4) | (u_int64_t)((c & 0xf) + 9 * (c >> 6));
+    }
+    return limb;
+}
+
+// Fill limbs[0, n) from the 16*n digits ending at `end`, least significant limb last in
+// the string.
+static void APIntHexDecodeScalar(u_int64_t *limbs, size_t n, const char *end)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        limbs[i] = APIntHexDecodeLimb(end - APINT_HEX_PER_LIMB * (i + 1));
+    }
+}
+
+#ifdef APINT_HEX_X86
+__attribute__((target("ssse3")))
+static void APIntHexDecodeSSSE3(u_int64_t *limbs, size_t n, const char *end)
+{
+    const __m128i lowMask = _mm_set1_epi8(0x0f);
+    const __m128i letter = _mm_set1_epi8(0x40);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i weights = _mm_set1_epi16(0x0110);     // 16 for the high digit, 1 for the low
+
+    for (size_t i = 0; i < n; i++)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i*)(end - APINT_HEX_PER_LIMB * (i + 1)));
+        __m128i digits = _mm_add_epi8(_mm_and_si128(c, lowMask),
+                                      _mm_and_si128(_mm_cmpgt_epi8(c, letter), nine));
+
+        // digit pairs become bytes, still most significant first
+        __m128i bytes = _mm_packus_epi16(_mm_maddubs_epi16(digits, weights), _mm_setzero_si128());
+        limbs[i] = __builtin_bswap64((u_int64_t)_mm_cvtsi128_si64(bytes));
+    }
+}
+
+__attribute__((target("avx2")))
+static void APIntHexDecodeAVX2(u_int64_t *limbs, size_t n, const char *end)
+{
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    const __m256i letter = _mm256_set1_epi8(0x40);
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+
+    // 32 digits per step; the first 16 belong to the more significant limb
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m256i c = _mm256_loadu_si256((const __m256i*)(end - APINT_HEX_PER_LIMB * (i + 2)));
+        __m256i digits = _mm256_add_epi8(_mm256_and_si256(c, lowMask),
+                                         _mm256_and_si256(_mm256_cmpgt_epi8(c, letter), nine));
+
+        // packing works per 128-bit lane, leaving each limb's bytes in its lane's low half
+        __m256i bytes = _mm256_packus_epi16(_mm256_maddubs_epi16(digits, weights), _mm256_setzero_si256());
+        limbs[i + 1] = __builtin_bswap64((u_int64_t)_mm256_extract_epi64(bytes, 0));
+        limbs[i] = __builtin_bswap64((u_int64_t)_mm256_extract_epi64(bytes, 2));
+    }
+    if (i < n) limbs[i] = APIntHexDecodeLimb(end - APINT_HEX_PER_LIMB * (i + 1));
+}
+#endif
+
+// Fill limbs[0, n) from the 16*n digits ending at `end` with the widest decoder the CPU has.
+static void APIntHexDecode(u_int64_t *limbs, size_t n, const char *end)
+{
+#ifdef APINT_HEX_X86
+    if (__builtin_cpu_supports("avx2"))
+    {
+        APIntHexDecodeAVX2(limbs, n, end);
+        return;
+    }
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        APIntHexDecodeSSSE3(limbs, n, end);
+        return;
+    }
+#endif
+    APIntHexDecodeScalar(limbs, n, end);
+}
+
+void APIntHexToAPIntN(const char *hexStr, size_t hexLen, APInt *apint)
+{
+    // leading zeros would only leave zero limbs on top
+    while (hexLen > 0 && *hexStr == '0')
+    {
+        hexStr++;
+        hexLen--;
+    }
+
+    // full limbs come from the end of the string; a partially filled limb on top takes
+    // whatever digits are left, so odd lengths need no padding
+    size_t fullLimbs = hexLen / APINT_HEX_PER_LIMB;
+    size_t topDigits = hexLen % APINT_HEX_PER_LIMB;
+    apint->size = fullLimbs + (topDigits > 0);
+    if (apint->size == 0) apint->size = 1;
+
+    if (APIntAllocLimbs(apint, apint->size) == NULL)  // error check
+    {
+        fprintf(stderr, "Error: Hex to number failed; could not allocate sufficient memory.\n");
+        exit(1);
+    }
+
+    apint->limbs[apint->size - 1] = APIntHexDecodePartial(hexStr, topDigits);
+    APIntHexDecode(apint->limbs, fullLimbs, hexStr + hexLen);
+}
+
+void APIntHexToAPInt(char *hexStr, APInt *apint)
+{
+    APIntHexToAPIntN(hexStr, strlen(hexStr), apint);
+}
+
+
+// ### ENCODING
+
+static const char APIntHexDigits[16] = {
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
+};
+
+// both digits of every byte value, high digit first
+#define APINT_HEX_DIGIT(d) (char)((d) < 10 ? '0' + (d) : 'a' - 10 + (d))
+#define APINT_HEX_PAIR(b) {APINT_HEX_DIGIT((b) >> 4), APINT_HEX_DIGIT((b) & 0xf)}
+#define APINT_HEX_PAIRS4(b) APINT_HEX_PAIR(b), APINT_HEX_PAIR((b) + 1), APINT_HEX_PAIR((b) + 2), \
+    APINT_HEX_PAIR((b) + 3)
+#define APINT_HEX_PAIRS16(b) APINT_HEX_PAIRS4(b), APINT_HEX_PAIRS4((b) + 4), APINT_HEX_PAIRS4((b) + 8), \
+    APINT_HEX_PAIRS4((b) + 12)
+#define APINT_HEX_PAIRS64(b) APINT_HEX_PAIRS16(b), APINT_HEX_PAIRS16((b) + 16), APINT_HEX_PAIRS16((b) + 32), \
+    APINT_HEX_PAIRS16((b) + 48)
+
+static const char APIntHexPairs[256][2] = {
+    APINT_HEX_PAIRS64(0), APINT_HEX_PAIRS64(64), APINT_HEX_PAIRS64(128), APINT_HEX_PAIRS64(192)
+};
+
+// Write the sixteen digits of each of limbs[0, n) below `end`, least significant limb
+// last in the string.
+static void APIntHexEncodeScalar(char *end, const u_int64_t *limbs, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        u_int64_t limb = limbs[i];
+        char *out = end - APINT_HEX_PER_LIMB * i;
+        for (int k = 0; k < APINT_HEX_PER_LIMB / 2; k++)
+        {
+            out -= 2;
+            memcpy(out, APIntHexPairs[limb & 0xff], 2);
+            limb >>= 8;
+        }
+    }
+}
+
+#ifdef APINT_HEX_X86
+__attribute__((target("ssse3")))
+static void APIntHexEncodeSSSE3(char *end, const u_int64_t *limbs, size_t n)
+{
+    const __m128i lowMask = _mm_set1_epi8(0x0f);
+    const __m128i table = _mm_loadu_si128((const __m128i*)APIntHexDigits);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        // bytes most significant first, then split into high and low digits, interleaved
+        __m128i bytes = _mm_cvtsi64_si128((long long)__builtin_bswap64(limbs[i]));
+        __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), lowMask);
+        __m128i low = _mm_and_si128(bytes, lowMask);
+        __m128i digits = _mm_shuffle_epi8(table, _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i*)(end - APINT_HEX_PER_LIMB * (i + 1)), digits);
+    }
+}
+#endif
+
+// Write the sixteen digits of each of limbs[0, n) below `end`.
+static void APIntHexEncode(char *end, const u_int64_t *limbs, size_t n)
+{
+#ifdef APINT_HEX_X86
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        APIntHexEncodeSSSE3(end, limbs, n);
+        return;
+    }
+#endif
+    APIntHexEncodeScalar(end, limbs, n);
+}
+
+// hex digits of the most significant limb, padded to an even count
+static size_t APIntHexTopDigits(const APInt *apint)
+{
+    u_int64_t topLimb = apint->limbs[apint->size - 1];
+    size_t bits = (topLimb == 0) ? 1 : (size_t)(APINT_LIMB_BITS - __builtin_clzll(topLimb));
+    size_t digits = (bits + 3) / 4;
+    return digits + digits % 2;
+}
+
+size_t APIntToHex(const APInt *apint, char *out, size_t cap)
+{
+    size_t topDigits = APIntHexTopDigits(apint);
+    size_t length = topDigits + APINT_HEX_PER_LIMB * (apint->size - 1);
+    if (length > cap) return length;
+
+    // top limb digit by digit, the rest a whole limb at a time
+    u_int64_t topLimb = apint->limbs[apint->size - 1];
+    for (size_t k = topDigits; k-- > 0;)
+    {
+        out[k] = APIntHexDigits[topLimb & 0xf];
+        topLimb >>= 4;
+    }
+    APIntHexEncode(out + length, apint->limbs, apint->size - 1);
+    return length;
+}
+
+void APIntPrintAsHex(const APInt *apint, FILE *stream)
+{
+    // "0x", the digits and a newline, written at once
+    size_t length = APIntToHex(apint, NULL, 0);
+    char *hexStr = (char*)APIntMalloc(length + 3);
+    if (hexStr == NULL)  // error check
+    {
+        fprintf(stderr, "Error: Print failed; could not allocate sufficient memory.\n");
+        exit(1);
+    }
+
+    hexStr[0] = '0';
+    hexStr[1] = 'x';
+    APIntToHex(apint, hexStr + 2, length);
+    hexStr[length + 2] = '\n';
+
+    fwrite(hexStr, 1, length + 3, stream);
+    APIntFree(hexStr, length + 3);
+}
@@ -0,0 +1,267 @@
+#include "APIntLimbs.h"
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+size_t APIntSignificantLimbs(const u_int64_t *limbs, size_t size)
+{
+    while (size > 1 && limbs[size - 1] == 0) size--;
+    return size;
+}
+
+int APIntLimbsCmp(const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn)
+{
+    an = APIntSignificantLimbs(ap, an);
+    bn = APIntSignificantLimbs(bp, bn);
+    if (an != bn) return (an > bn) ? 1 : -1;
+
+    for (size_t i = an; i-- > 0;)
+    {
+        if (ap[i] != bp[i]) return (ap[i] > bp[i]) ? 1 : -1;
+    }
+    return 0;
+}
+
+// One limb of a carry chain: *r = a + b + carry, returning the carry out. On x86-64 these
+// map to adc/sbb so the unrolled loops below keep the carry in the flags.
+#if defined(__x86_64__) && defined(__GNUC__)
+static inline unsigned char APIntAddCarry(unsigned char carry, u_int64_t a, u_int64_t b, u_int64_t *r)
+{
+    unsigned long long sum;
+    carry = _addcarry_u64(carry, a, b, &sum);
+    *r = sum;
+    return carry;
+}
+
+static inline unsigned char APIntSubBorrow(unsigned char borrow, u_int64_t a, u_int64_t b, u_int64_t *r)
+{
+    unsigned long long diff;
+    borrow = _subborrow_u64(borrow, a, b, &diff);
+    *r = diff;
+    return borrow;
+}
+#else
+static inline unsigned char APIntAddCarry(unsigned char carry, u_int64_t a, u_int64_t b, u_int64_t *r)
+{
+    u_int128_t sum = (u_int128_t)a + b + carry;
+    *r = (u_int64_t)sum;
+    return (unsigned char)(sum >> APINT_LIMB_BITS);
+}
+
+static inline unsigned char APIntSubBorrow(unsigned char borrow, u_int64_t a, u_int64_t b, u_int64_t *r)
+{
+    u_int128_t diff = (u_int128_t)a - b - borrow;
+    *r = (u_int64_t)diff;
+    return (unsigned char)(diff >> APINT_LIMB_BITS) & 1;
+}
+#endif
+
+u_int64_t APIntLimbsAddN(u_int64_t *rp, const u_int64_t *ap, const u_int64_t *bp, size_t n)
+{
+    unsigned char carry = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        carry = APIntAddCarry(carry, ap[i], bp[i], &rp[i]);
+        carry = APIntAddCarry(carry, ap[i + 1], bp[i + 1], &rp[i + 1]);
+        carry = APIntAddCarry(carry, ap[i + 2], bp[i + 2], &rp[i + 2]);
+        carry = APIntAddCarry(carry, ap[i + 3], bp[i + 3], &rp[i + 3]);
+    }
+    for (; i < n; i++)
+    {
+        carry = APIntAddCarry(carry, ap[i], bp[i], &rp[i]);
+    }
+    return carry;
+}
+
+u_int64_t APIntLimbsAdd(u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn)
+{
+    u_int64_t carry = APIntLimbsAddN(rp, ap, bp, bn);
+
+    // propagate carry along the longer operand until it dies out, then copy the rest
+    size_t i = bn;
+    for (; carry && i < an; i++)
+    {
+        rp[i] = ap[i] + 1;
+        carry = (rp[i] == 0);
+    }
+    if (rp != ap && i < an) memmove(rp + i, ap + i, (an - i) * sizeof(u_int64_t));
+    return carry;
+}
+
+u_int64_t APIntLimbsSubN(u_int64_t *rp, const u_int64_t *ap, const u_int64_t *bp, size_t n)
+{
+    unsigned char borrow = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        borrow = APIntSubBorrow(borrow, ap[i], bp[i], &rp[i]);
+        borrow = APIntSubBorrow(borrow, ap[i + 1], bp[i + 1], &rp[i + 1]);
+        borrow = APIntSubBorrow(borrow, ap[i + 2], bp[i + 2], &rp[i + 2]);
+        borrow = APIntSubBorrow(borrow, ap[i + 3], bp[i + 3], &rp[i + 3]);
+    }
+    for (; i < n; i++)
+    {
+        borrow = APIntSubBorrow(borrow, ap[i], bp[i], &rp[i]);
+    }
+    return borrow;
+}
+
+u_int64_t APIntLimbsSub(u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn)
+{
+    u_int64_t borrow = APIntLimbsSubN(rp, ap, bp, bn);
+
+    // propagate borrow along the longer operand until it dies out, then copy the rest
+    size_t i = bn;
+    for (; borrow && i < an; i++)
+    {
+        u_int64_t limb = ap[i];
+        rp[i] = limb - 1;
+        borrow = (limb == 0);
+    }
+    if (rp != ap && i < an) memmove(rp + i, ap + i, (an - i) * sizeof(u_int64_t));
+    return borrow;
+}
+
+u_int64_t APIntLimbsLShift(u_int64_t *rp, const u_int64_t *ap, size_t n, unsigned bits)
+{
+    if (bits == 0)
+    {
+        memmove(rp, ap, n * sizeof(u_int64_t));
+        return 0;
+    }
+
+    // walk down from the top so rp may sit at or above ap
+    u_int64_t out = ap[n - 1] >> (APINT_LIMB_BITS - bits);
+    for (size_t i = n - 1; i > 0; i--)
+    {
+        rp[i] = (ap[i] << bits) | (ap[i - 1] >> (APINT_LIMB_BITS - bits));
+    }
+    rp[0] = ap[0] << bits;
+    return out;
+}
+
+u_int64_t APIntLimbsRShift(u_int64_t *rp, const u_int64_t *ap, size_t n, unsigned bits)
+{
+    if (bits == 0)
+    {
+        memmove(rp, ap, n * sizeof(u_int64_t));
+        return 0;
+    }
+
+    // walk up from the bottom so rp may sit at or below ap
+    u_int64_t out = ap[0] << (APINT_LIMB_BITS - bits);
+    for (size_t i = 0; i + 1 < n; i++)
+    {
+        rp[i] = (ap[i] >> bits) | (ap[i + 1] << (APINT_LIMB_BITS - bits));
+    }
+    rp[n - 1] = ap[n - 1] >> bits;
+    return out;
+}
+
+u_int64_t APIntLimbsAddLShift(u_int64_t *rp, const u_int64_t *ap, size_t n, unsigned bits)
+{
+    if (bits == 0) return APIntLimbsAddN(rp, rp, ap, n);
+
+    // each shifted limb is put together from its two neighbours on the way up and added
+    // at once, so rp may equal ap
+    unsigned char carry = 0;
+    u_int64_t below = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        u_int64_t limb = (ap[i] << bits) | (below >> (APINT_LIMB_BITS - bits));
+        below = ap[i];
+        carry = APIntAddCarry(carry, rp[i], limb, &rp[i]);
+    }
+    return (below >> (APINT_LIMB_BITS - bits)) + carry;
+}
+
+u_int64_t APIntLimbsMul1(u_int64_t *rp, const u_int64_t *ap, size_t n, u_int64_t b)
+{
+    u_int64_t carry = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        u_int128_t prod = (u_int128_t)ap[i] * b + carry;
+        rp[i] = (u_int64_t)prod;
+        carry = (u_int64_t)(prod >> APINT_LIMB_BITS);
+    }
+    return carry;
+}
+
+u_int64_t APIntLimbsAddMul1(u_int64_t *rp, const u_int64_t *ap, size_t n, u_int64_t b)
+{
+    u_int64_t carry = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        // a*b + r + carry < 2^128, so the accumulation itself never overflows
+        u_int128_t prod = (u_int128_t)ap[i] * b + rp[i] + carry;
+        rp[i] = (u_int64_t)prod;
+        carry = (u_int64_t)(prod >> APINT_LIMB_BITS);
+    }
+    return carry;
+}
+
+u_int64_t APIntLimbsSubMul1(u_int64_t *rp, const u_int64_t *ap, size_t n, u_int64_t b)
+{
+    u_int64_t borrow = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        // the product and incoming borrow come off r as one 128-bit amount
+        u_int128_t prod = (u_int128_t)ap[i] * b + borrow;
+        u_int64_t low = (u_int64_t)prod;
+        borrow = (u_int64_t)(prod >> APINT_LIMB_BITS) + (rp[i] < low);
+        rp[i] -= low;
+    }
+    return borrow;
+}
+
+void APIntLimbsMulBasecase(u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn)
+{
+    // first row initializes the product, every later row accumulates into it
+    rp[an] = APIntLimbsMul1(rp, ap, an, bp[0]);
+    for (size_t j = 1; j < bn; j++)
+    {
+        rp[an + j] = APIntLimbsAddMul1(rp + j, ap, an, bp[j]);
+    }
+}
+
+void APIntLimbsSqrBasecase(u_int64_t *rp, const u_int64_t *ap, size_t n)
+{
+    if (n == 1)
+    {
+        u_int128_t sq = (u_int128_t)ap[0] * ap[0];
+        rp[0] = (u_int64_t)sq;
+        rp[1] = (u_int64_t)(sq >> APINT_LIMB_BITS);
+        return;
+    }
+
+    // cross products a[i]*a[j] with i < j, each computed once; row i starts at i + i + 1
+    rp[0] = 0;
+    rp[n] = APIntLimbsMul1(rp + 1, ap + 1, n - 1, ap[0]);
+    for (size_t i = 1; i + 1 < n; i++)
+    {
+        rp[n + i] = APIntLimbsAddMul1(rp + 2 * i + 1, ap + i + 1, n - 1 - i, ap[i]);
+    }
+    rp[2 * n - 1] = 0;
+
+    // double them; their sum is below B^2n / 2, so no bit leaves the top
+    for (size_t i = 2 * n - 1; i > 0; i--)
+    {
+        rp[i] = (rp[i] << 1) | (rp[i - 1] >> (APINT_LIMB_BITS - 1));
+    }
+    rp[0] <<= 1;
+
+    // add the squares a[i]^2 down the diagonal
+    u_int64_t carry = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        u_int128_t sq = (u_int128_t)ap[i] * ap[i];
+        u_int128_t lo = (u_int128_t)rp[2 * i] + (u_int64_t)sq + carry;
+        u_int128_t hi = (u_int128_t)rp[2 * i + 1] + (u_int64_t)(sq >> APINT_LIMB_BITS) + (u_int64_t)(lo >> APINT_LIMB_BITS);
+        rp[2 * i] = (u_int64_t)lo;
+        rp[2 * i + 1] = (u_int64_t)hi;
+        carry = (u_int64_t)(hi >> APINT_LIMB_BITS);
+    }
+}
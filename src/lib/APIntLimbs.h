@@ -0,0 +1,184 @@
+#ifndef APINT_LIMBS_H
+#define APINT_LIMBS_H
+
+#include "APInt.h"
+
+/* Internal limb-array kernels shared by the APInt library sources; not installed. */
+
+// double-limb type for full 64x64 bit products
+__extension__ typedef unsigned __int128 u_int128_t;
+
+// Compile-time defaults for the multiplication tiers, in limbs of the smaller
+// factor; override with -D at build time or APIntSetThreshold at run time.
+#ifndef APINT_KARATSUBA_THRESHOLD
+#define APINT_KARATSUBA_THRESHOLD 32
+#endif
+
+#ifndef APINT_TOOM3_THRESHOLD
+#define APINT_TOOM3_THRESHOLD 128
+#endif
+
+// the NTT overtakes Toom-3 near 4096 limbs (256 Kbit); measure with the bench target
+#ifndef APINT_NTT_THRESHOLD
+#define APINT_NTT_THRESHOLD 4096
+#endif
+
+// below 1 Mbit a product is over before extra threads would pay for themselves
+#ifndef APINT_PARALLEL_THRESHOLD
+#define APINT_PARALLEL_THRESHOLD 16384
+#endif
+
+// divisors from here on divide and conquer instead of by schoolbook
+#ifndef APINT_DIVIDE_THRESHOLD
+#define APINT_DIVIDE_THRESHOLD 64
+#endif
+
+#if APINT_KARATSUBA_THRESHOLD < 2 || APINT_TOOM3_THRESHOLD < 5 || APINT_DIVIDE_THRESHOLD < 2
+#error "APInt multiplication thresholds are below the smallest size their tier can split"
+#endif
+
+// current run-time thresholds, indexed by APIntThreshold
+extern size_t APIntThresholds[APINT_THRESHOLD_COUNT];
+
+
+// ### MEMORY
+
+// Heap blocks of the library, routed through the allocator hook.
+void *APIntMalloc(size_t size);
+void *APIntRealloc(void *ptr, size_t oldSize, size_t newSize);
+void APIntFree(void *ptr, size_t size);
+
+// Position in the calling thread's scratch arena.
+typedef struct APIntArenaMark {
+    void *block;
+    size_t used;
+} APIntArenaMark;
+
+// Scratch limbs are handed out stack-wise: save a mark, allocate, and restore the mark
+// to release everything allocated since in one step. Allocation never fails; running
+// out of memory exits like the rest of the library.
+APIntArenaMark APIntArenaSave(void);
+void APIntArenaRestore(APIntArenaMark);
+u_int64_t *APIntArenaAlloc(size_t limbs);
+
+// Free the calling thread's cached powers of a radix (APIntRadix.c).
+void APIntRadixRelease(void);
+
+
+// ### THREADS
+
+// one task of a parallel group, called with the group's argument and its own index
+typedef void (*APIntTaskFn)(void *arg, size_t index);
+
+// Threads to spread an NTT product over when its smaller factor has `limbs` limbs; 1
+// below the parallel threshold or while the pool is off.
+size_t APIntParallelThreads(size_t limbs);
+
+// Run fn(arg, i) for every i in [0, count), on the pool's threads when it has any, and
+// return once all are done. Tasks may run groups of their own.
+void APIntParallelRun(APIntTaskFn fn, void *arg, size_t count);
+
+
+// ### HELPERS
+
+// Point a fresh APInt at storage for `limbs` limbs, inline when they fit; returns the
+// limbs, or NULL if the allocation fails.
+u_int64_t *APIntAllocLimbs(APInt*, size_t limbs);
+
+// Grow apint to hold at least `limbs` limbs, keeping its contents, and give it limbs of
+// its own if they are borrowed or shared with a clone; every write into an initialized
+// APInt goes through here first. Returns 0 if the allocation fails, leaving apint untouched.
+int APIntReserve(APInt*, size_t limbs);
+
+// number of limbs remaining once zero limbs on top are discarded; zero keeps one limb
+size_t APIntSignificantLimbs(const u_int64_t*, size_t);
+
+// Compare ap[0, an) with bp[0, bn) as numbers; either may carry zero limbs on top.
+int APIntLimbsCmp(const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn);
+
+
+// ### ADDITION AND SUBTRACTION
+// Raw little endian limb arrays; callers size the destination and handle normalization.
+
+// rp[0, n) = ap[0, n) + bp[0, n); returns the carry out of the top.
+u_int64_t APIntLimbsAddN(u_int64_t *rp, const u_int64_t *ap, const u_int64_t *bp, size_t n);
+
+// rp[0, an) = ap[0, an) + bp[0, bn) with an >= bn; returns the carry out of the top.
+u_int64_t APIntLimbsAdd(u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn);
+
+// rp[0, n) = ap[0, n) - bp[0, n); returns the borrow out of the top.
+u_int64_t APIntLimbsSubN(u_int64_t *rp, const u_int64_t *ap, const u_int64_t *bp, size_t n);
+
+// rp[0, an) = ap[0, an) - bp[0, bn) with an >= bn; returns the borrow out of the top.
+u_int64_t APIntLimbsSub(u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn);
+
+
+// ### SHIFTS
+// Shift by 0 <= bits < APINT_LIMB_BITS; rp may equal ap.
+
+// rp[0, n) = ap[0, n) << bits; returns the bits shifted out of the top, low aligned.
+u_int64_t APIntLimbsLShift(u_int64_t *rp, const u_int64_t *ap, size_t n, unsigned bits);
+
+// rp[0, n) = ap[0, n) >> bits; returns the bits shifted out of the bottom, high aligned.
+u_int64_t APIntLimbsRShift(u_int64_t *rp, const u_int64_t *ap, size_t n, unsigned bits);
+
+// rp[0, n) += ap[0, n) << bits; returns the bits shifted out of the top plus the carry.
+u_int64_t APIntLimbsAddLShift(u_int64_t *rp, const u_int64_t *ap, size_t n, unsigned bits);
+
+
+// ### MULTIPLICATION
+
+// rp[0, n) = ap[0, n) * b; returns the limb carried out of the top.
+u_int64_t APIntLimbsMul1(u_int64_t *rp, const u_int64_t *ap, size_t n, u_int64_t b);
+
+// rp[0, n) += ap[0, n) * b; returns the limb carried out of the top.
+u_int64_t APIntLimbsAddMul1(u_int64_t *rp, const u_int64_t *ap, size_t n, u_int64_t b);
+
+// rp[0, n) -= ap[0, n) * b; returns the limb borrowed from above the top.
+u_int64_t APIntLimbsSubMul1(u_int64_t *rp, const u_int64_t *ap, size_t n, u_int64_t b);
+
+// Schoolbook product rp[0, an + bn) = ap[0, an) * bp[0, bn); requires an >= bn >= 1 and
+// rp not overlapping either factor.
+void APIntLimbsMulBasecase(u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn);
+
+// Schoolbook square rp[0, 2n) = ap[0, n)^2 computing each cross product once; requires
+// n >= 1 and rp not overlapping ap.
+void APIntLimbsSqrBasecase(u_int64_t *rp, const u_int64_t *ap, size_t n);
+
+// Limbs of scratch space `APIntLimbsMul` needs for factors of an and bn limbs (an >= bn).
+size_t APIntLimbsMulScratch(size_t an, size_t bn);
+
+// Nonzero if a product of an + bn limbs fits the largest transform of the NTT tier.
+int APIntLimbsMulNTTFits(size_t an, size_t bn);
+
+// Limbs of scratch space `APIntLimbsMulNTT` needs for factors of an and bn limbs.
+size_t APIntLimbsMulNTTScratch(size_t an, size_t bn);
+
+// Three-prime NTT product rp[0, an + bn) = ap[0, an) * bp[0, bn); requires
+// `APIntLimbsMulNTTFits(an, bn)`, rp not overlapping either factor, and
+// `APIntLimbsMulNTTScratch(an, bn)` limbs of scratch; per-prime buffers come from the
+// arena of the thread convolving that prime. Passing the same factor twice transforms
+// it only once.
+void APIntLimbsMulNTT(u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn,
+                      u_int64_t *scratch);
+
+// Product rp[0, an + bn) = ap[0, an) * bp[0, bn), choosing schoolbook, Karatsuba,
+// Toom-3 or NTT by size; requires an >= bn >= 1, rp not overlapping either factor, and
+// `APIntLimbsMulScratch(an, bn)` limbs of scratch. Passing the same array as both
+// factors selects the squaring variant of every tier.
+void APIntLimbsMul(u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn,
+                   u_int64_t *scratch);
+
+
+// ### DIVISION
+
+// qp[0, n) = ap[0, n) / d for d != 0; returns the remainder. qp may equal ap.
+u_int64_t APIntLimbsDivRem1(u_int64_t *qp, const u_int64_t *ap, size_t n, u_int64_t d);
+
+// qp[0, an - dn + 1) = ap[0, an) / dp[0, dn) and rp[0, dn) = the remainder, schoolbook or
+// divide and conquer by size; requires an >= dn >= 1, a nonzero top divisor limb, and
+// outputs not overlapping the inputs. Scratch comes from the arena.
+void APIntLimbsDivRem(u_int64_t *qp, u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *dp,
+                      size_t dn);
+
+#endif
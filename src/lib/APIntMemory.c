@@ -0,0 +1,162 @@
+#include "APIntLimbs.h"
+#include <string.h>
+
+/* Memory management for the APInt library. Every heap block goes through the
+ * allocator hook, which defaults to the C library. Temporaries of the multiply and
+ * power paths come from a per-thread arena: a chain of large blocks handed out
+ * stack-wise and kept for the next call, so steady-state arithmetic does not touch
+ * the allocator at all. */
+
+// ### ALLOCATOR HOOK
+
+static void *APIntDefaultAlloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void *APIntDefaultRealloc(void *ptr, size_t oldSize, size_t newSize)
+{
+    (void)oldSize;
+    return realloc(ptr, newSize);
+}
+
+static void APIntDefaultFree(void *ptr, size_t size)
+{
+    (void)size;
+    free(ptr);
+}
+
+static void *(*APIntAllocFn)(size_t) = APIntDefaultAlloc;
+static void *(*APIntReallocFn)(void*, size_t, size_t) = APIntDefaultRealloc;
+static void (*APIntFreeFn)(void*, size_t) = APIntDefaultFree;
+
+void APIntSetAllocator(void *(*allocFn)(size_t),
+                       void *(*reallocFn)(void*, size_t, size_t),
+                       void (*freeFn)(void*, size_t))
+{
+    APIntAllocFn = (allocFn != NULL) ? allocFn : APIntDefaultAlloc;
+    APIntReallocFn = (reallocFn != NULL) ? reallocFn : APIntDefaultRealloc;
+    APIntFreeFn = (freeFn != NULL) ? freeFn : APIntDefaultFree;
+}
+
+void *APIntMalloc(size_t size)
+{
+    return APIntAllocFn(size);
+}
+
+void *APIntRealloc(void *ptr, size_t oldSize, size_t newSize)
+{
+    if (ptr == NULL) return APIntAllocFn(newSize);
+    return APIntReallocFn(ptr, oldSize, newSize);
+}
+
+void APIntFree(void *ptr, size_t size)
+{
+    if (ptr != NULL) APIntFreeFn(ptr, size);
+}
+
+
+// ### SCRATCH ARENA
+
+// smallest block the arena asks the allocator for, in limbs (256 KiB)
+#define APINT_ARENA_BLOCK (1u << 15)
+
+typedef struct APIntArenaBlock {
+    struct APIntArenaBlock *next;   // later block, kept for reuse once released
+    size_t capacity;                // limbs in `limbs`
+    u_int64_t limbs[];
+} APIntArenaBlock;
+
+typedef struct APIntArena {
+    APIntArenaBlock *first;
+    APIntArenaBlock *current;       // block allocations are taken from
+    size_t used;                    // limbs of `current` handed out
+} APIntArena;
+
+static __thread APIntArena APIntThreadArena;
+
+static size_t APIntArenaBlockBytes(size_t capacity)
+{
+    return sizeof(APIntArenaBlock) + capacity * sizeof(u_int64_t);
+}
+
+static APIntArenaBlock *APIntArenaNewBlock(size_t capacity)
+{
+    APIntArenaBlock *block = (APIntArenaBlock*)APIntMalloc(APIntArenaBlockBytes(capacity));
+    if (block == NULL)  // error check
+    {
+        fprintf(stderr, "Error: Scratch allocation failed; could not allocate sufficient memory.\n");
+        exit(1);
+    }
+    block->next = NULL;
+    block->capacity = capacity;
+    return block;
+}
+
+// free `block` and every block after it
+static void APIntArenaFreeChain(APIntArenaBlock *block)
+{
+    while (block != NULL)
+    {
+        APIntArenaBlock *next = block->next;
+        APIntFree(block, APIntArenaBlockBytes(block->capacity));
+        block = next;
+    }
+}
+
+APIntArenaMark APIntArenaSave(void)
+{
+    APIntArena *arena = &APIntThreadArena;
+    APIntArenaMark mark = {arena->current, arena->used};
+    return mark;
+}
+
+void APIntArenaRestore(APIntArenaMark mark)
+{
+    // later blocks stay chained for reuse
+    APIntArena *arena = &APIntThreadArena;
+    arena->current = (APIntArenaBlock*)mark.block;
+    arena->used = mark.used;
+}
+
+u_int64_t *APIntArenaAlloc(size_t limbs)
+{
+    APIntArena *arena = &APIntThreadArena;
+    if (limbs == 0) limbs = 1;
+
+    if (arena->current != NULL && arena->current->capacity - arena->used >= limbs)
+    {
+        u_int64_t *ptr = arena->current->limbs + arena->used;
+        arena->used += limbs;
+        return ptr;
+    }
+
+    // move on to the next block, replacing it (and what follows) when it is too small
+    APIntArenaBlock **link = (arena->current != NULL) ? &arena->current->next : &arena->first;
+    if (*link != NULL && (*link)->capacity < limbs)
+    {
+        APIntArenaFreeChain(*link);
+        *link = NULL;
+    }
+    if (*link == NULL)
+    {
+        size_t capacity = (arena->current != NULL) ? 2 * arena->current->capacity : APINT_ARENA_BLOCK;
+        if (capacity < limbs) capacity = limbs;
+        *link = APIntArenaNewBlock(capacity);
+    }
+
+    arena->current = *link;
+    arena->used = limbs;
+    return arena->current->limbs;
+}
+
+void APIntReleaseScratch(void)
+{
+    APIntRadixRelease();
+
+    APIntArena *arena = &APIntThreadArena;
+    if (arena->current != NULL || arena->used != 0) return;   // scratch still in use
+
+    APIntArenaFreeChain(arena->first);
+    arena->first = NULL;
+}
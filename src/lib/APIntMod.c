@@ -0,0 +1,282 @@
+#include "APIntLimbs.h"
+#include <string.h>
+
+/* Modular arithmetic by Montgomery reduction. For an odd modulus m of n limbs and
+ * R = 2^(64n), a residue x is held as xR mod m. Reducing a product of two such
+ * residues divides it by R (REDC), which takes multiplications only, and leaves the
+ * result in the same form; nothing ever divides by m. A context holds m with the
+ * constants every operation reuses: -1/m mod 2^64, R mod m and R^2 mod m. */
+
+// widest sliding window APIntModPow uses; its table holds 2^(k-1) residues
+#define APINT_MOD_MAX_WINDOW 6
+
+
+// ### REDUCTION
+
+// -1/m0 mod 2^64 for odd m0 by Newton's iteration; m0 is its own inverse to 3 bits, and
+// each step doubles the bits that are right
+static u_int64_t APIntModInverse(u_int64_t m0)
+{
+    u_int64_t inverse = m0;
+    for (int i = 0; i < 5; i++) inverse *= 2 - m0 * inverse;
+    return -inverse;
+}
+
+// rp[0, n) = tp[0, 2n) / R mod m, for tp below mR; tp is overwritten.
+static void APIntModRedc(u_int64_t *rp, u_int64_t *tp, const APIntModContext *ctx)
+{
+    size_t n = ctx->size;
+    const u_int64_t *m = ctx->modulus;
+
+    // adding a multiple of m clears one limb at a time; its carry belongs n limbs up and
+    // waits in the cleared limb until all are added at once
+    for (size_t i = 0; i < n; i++)
+    {
+        u_int64_t q = tp[i] * ctx->inverse;
+        tp[i] = APIntLimbsAddMul1(tp + i, m, n, q);
+    }
+
+    // below 2m; one subtraction finishes
+    u_int64_t carry = APIntLimbsAddN(rp, tp + n, tp, n);
+    if (carry || APIntLimbsCmp(rp, n, m, n) >= 0) APIntLimbsSubN(rp, rp, m, n);
+}
+
+// rp[0, n) = ap[0, n) * bp[0, n) / R mod m, for a product below mR; rp may be either
+// factor, and ap == bp squares.
+static void APIntModMulLimbs(u_int64_t *rp, const u_int64_t *ap, const u_int64_t *bp, const APIntModContext *ctx)
+{
+    size_t n = ctx->size;
+    APIntArenaMark mark = APIntArenaSave();
+    u_int64_t *tp = APIntArenaAlloc(2 * n);
+    size_t scratchSize = APIntLimbsMulScratch(n, n);
+    u_int64_t *scratch = (scratchSize > 0) ? APIntArenaAlloc(scratchSize) : NULL;
+
+    APIntLimbsMul(tp, ap, n, bp, n, scratch);
+    APIntModRedc(rp, tp, ctx);
+    APIntArenaRestore(mark);
+}
+
+// rp[0, n) = aR mod m for a = ap[0, an) of any size, taken n limbs at a time from the
+// top: with a = hR + l, aR = (hR)R + lR, and multiplying by R^2 then reducing is
+// multiplying by R.
+static void APIntModToMont(u_int64_t *rp, const u_int64_t *ap, size_t an, const APIntModContext *ctx)
+{
+    size_t n = ctx->size;
+    APIntArenaMark mark = APIntArenaSave();
+    u_int64_t *chunk = APIntArenaAlloc(n);
+
+    size_t chunks = (an + n - 1) / n;
+    for (size_t c = chunks; c-- > 0;)
+    {
+        size_t len = (an - c * n < n) ? an - c * n : n;
+        memcpy(chunk, ap + c * n, len * sizeof(u_int64_t));
+        memset(chunk + len, 0, (n - len) * sizeof(u_int64_t));
+        APIntModMulLimbs(chunk, chunk, ctx->r2, ctx);
+
+        if (c + 1 == chunks)
+        {
+            memcpy(rp, chunk, n * sizeof(u_int64_t));
+            continue;
+        }
+        APIntModMulLimbs(rp, rp, ctx->r2, ctx);
+        if (APIntLimbsAddN(rp, rp, chunk, n) || APIntLimbsCmp(rp, n, ctx->modulus, n) >= 0)
+            APIntLimbsSubN(rp, rp, ctx->modulus, n);
+    }
+    APIntArenaRestore(mark);
+}
+
+// rp[0, n) = x for the residue xR mod m at xp[0, n); rp may be xp.
+static void APIntModFromMont(u_int64_t *rp, const u_int64_t *xp, const APIntModContext *ctx)
+{
+    size_t n = ctx->size;
+    APIntArenaMark mark = APIntArenaSave();
+    u_int64_t *tp = APIntArenaAlloc(2 * n);
+    memcpy(tp, xp, n * sizeof(u_int64_t));
+    memset(tp + n, 0, n * sizeof(u_int64_t));
+    APIntModRedc(rp, tp, ctx);
+    APIntArenaRestore(mark);
+}
+
+// Store xp[0, n) into apint, which may be an operand already read.
+static void APIntModStore(const u_int64_t *xp, size_t n, APInt *apint)
+{
+    if (!APIntReserve(apint, n))  // error check
+    {
+        fprintf(stderr, "Error: Modular arithmetic failed; could not allocate sufficient memory.\n");
+        exit(1);
+    }
+    memcpy(apint->limbs, xp, n * sizeof(u_int64_t));
+    apint->size = APIntSignificantLimbs(apint->limbs, n);
+}
+
+
+// ### CONTEXT
+
+int APIntModInit(const APInt *modulus, APIntModContext *ctx)
+{
+    // Montgomery reduction needs an odd modulus
+    if ((modulus->limbs[0] & 1) == 0) return 0;
+
+    size_t n = modulus->size;
+    u_int64_t *block = (u_int64_t*)APIntMalloc(3 * n * sizeof(u_int64_t));
+    if (block == NULL)  // error check
+    {
+        fprintf(stderr, "Error: Modular context failed; could not allocate sufficient memory.\n");
+        exit(1);
+    }
+    ctx->size = n;
+    ctx->inverse = APIntModInverse(modulus->limbs[0]);
+    ctx->modulus = block;
+    ctx->one = block + n;
+    ctx->r2 = block + 2 * n;
+    memcpy(ctx->modulus, modulus->limbs, n * sizeof(u_int64_t));
+
+    // R mod m: the top bit of m is at most m, and at most 64 doublings reach R
+    u_int64_t *one = ctx->one;
+    u_int64_t bits = APINT_LIMB_BITS * (u_int64_t)n - (u_int64_t)__builtin_clzll(modulus->limbs[n - 1]);
+    memset(one, 0, n * sizeof(u_int64_t));
+    one[(bits - 1) / APINT_LIMB_BITS] = (u_int64_t)1 << ((bits - 1) % APINT_LIMB_BITS);
+    for (u_int64_t b = bits - 1; ; b++)
+    {
+        if (APIntLimbsCmp(one, n, ctx->modulus, n) >= 0) APIntLimbsSubN(one, one, ctx->modulus, n);
+        if (b == APINT_LIMB_BITS * (u_int64_t)n) break;
+        if (APIntLimbsLShift(one, one, n, 1)) APIntLimbsSubN(one, one, ctx->modulus, n);
+    }
+
+    // R^2 mod m is R in Montgomery form, 2^(64n) there: the residue of 2 raised to 64n
+    // with Montgomery products, which need no R^2 themselves
+    APIntArenaMark mark = APIntArenaSave();
+    u_int64_t *two = APIntArenaAlloc(n);
+    if (APIntLimbsAddN(two, one, one, n) || APIntLimbsCmp(two, n, ctx->modulus, n) >= 0)
+        APIntLimbsSubN(two, two, ctx->modulus, n);
+
+    u_int64_t power = APINT_LIMB_BITS * (u_int64_t)n;
+    memcpy(ctx->r2, one, n * sizeof(u_int64_t));
+    for (int i = APINT_LIMB_BITS - 1 - __builtin_clzll(power); i >= 0; i--)
+    {
+        APIntModMulLimbs(ctx->r2, ctx->r2, ctx->r2, ctx);
+        if ((power >> i) & 1) APIntModMulLimbs(ctx->r2, ctx->r2, two, ctx);
+    }
+    APIntArenaRestore(mark);
+    return 1;
+}
+
+void APIntModDestroy(APIntModContext *ctx)
+{
+    APIntFree(ctx->modulus, 3 * ctx->size * sizeof(u_int64_t));
+    ctx->modulus = ctx->one = ctx->r2 = NULL;
+    ctx->size = 0;
+}
+
+
+// ### OPERATIONS
+
+void APIntModMul(const APInt *apint_a, const APInt *apint_b, const APIntModContext *ctx, APInt *apint_result)
+{
+    size_t n = ctx->size;
+    APIntArenaMark mark = APIntArenaSave();
+    u_int64_t *aMont = APIntArenaAlloc(n);
+    u_int64_t *bp = APIntArenaAlloc(n);
+    APIntModToMont(aMont, apint_a->limbs, apint_a->size, ctx);
+
+    // aR times b, reduced, is ab; a b longer than m is brought below R first, as bR,
+    // and the product taken out of Montgomery form once more, as is a square
+    if (apint_b == apint_a)
+    {
+        APIntModMulLimbs(bp, aMont, aMont, ctx);
+        APIntModFromMont(bp, bp, ctx);
+    }
+    else if (apint_b->size <= n)
+    {
+        memcpy(bp, apint_b->limbs, apint_b->size * sizeof(u_int64_t));
+        memset(bp + apint_b->size, 0, (n - apint_b->size) * sizeof(u_int64_t));
+        APIntModMulLimbs(bp, aMont, bp, ctx);
+    }
+    else
+    {
+        APIntModToMont(bp, apint_b->limbs, apint_b->size, ctx);
+        APIntModMulLimbs(bp, aMont, bp, ctx);
+        APIntModFromMont(bp, bp, ctx);
+    }
+    APIntModStore(bp, n, apint_result);
+    APIntArenaRestore(mark);
+}
+
+// Window width for an exponent of `bits` bits: one more bit saves bits/(k+1) - bits/(k+2)
+// multiplications and costs 2^(k-1) more table entries.
+static int APIntModWindow(u_int64_t bits)
+{
+    if (bits <= 6) return 1;
+    if (bits <= 24) return 2;
+    if (bits <= 80) return 3;
+    if (bits <= 240) return 4;
+    if (bits <= 672) return 5;
+    return APINT_MOD_MAX_WINDOW;
+}
+
+// bit i of apint
+static unsigned APIntModBit(const APInt *apint, u_int64_t i)
+{
+    return (unsigned)(apint->limbs[i / APINT_LIMB_BITS] >> (i % APINT_LIMB_BITS)) & 1;
+}
+
+void APIntModPow(const APInt *apint, const APInt *exponent, const APIntModContext *ctx, APInt *apint_result)
+{
+    size_t n = ctx->size;
+    u_int64_t topLimb = exponent->limbs[exponent->size - 1];
+    u_int64_t ebits = APINT_LIMB_BITS * (u_int64_t)exponent->size - (topLimb ? (u_int64_t)__builtin_clzll(topLimb) : APINT_LIMB_BITS);
+
+    APIntArenaMark mark = APIntArenaSave();
+    u_int64_t *result = APIntArenaAlloc(n);
+    memcpy(result, ctx->one, n * sizeof(u_int64_t));
+
+    // table[j] = a^(2j + 1), in Montgomery form like everything below
+    int k = APIntModWindow(ebits);
+    u_int64_t *table[1 << (APINT_MOD_MAX_WINDOW - 1)];
+    table[0] = APIntArenaAlloc(n);
+    APIntModToMont(table[0], apint->limbs, apint->size, ctx);
+    if (k > 1)
+    {
+        u_int64_t *square = APIntArenaAlloc(n);
+        APIntModMulLimbs(square, table[0], table[0], ctx);
+        for (int j = 1; j < (1 << (k - 1)); j++)
+        {
+            table[j] = APIntArenaAlloc(n);
+            APIntModMulLimbs(table[j], table[j - 1], square, ctx);
+        }
+    }
+
+    // left to right: zero bits square, and each window of up to k bits ending in a one
+    // squares once per bit and multiplies by its odd power; the first copies it
+    int started = 0;
+    u_int64_t i = ebits;
+    while (i-- > 0)
+    {
+        if (!APIntModBit(exponent, i))
+        {
+            APIntModMulLimbs(result, result, result, ctx);
+            continue;
+        }
+
+        u_int64_t j = (i + 1 >= (u_int64_t)k) ? i + 1 - (u_int64_t)k : 0;
+        while (!APIntModBit(exponent, j)) j++;
+        size_t window = 0;
+        for (u_int64_t b = i + 1; b-- > j;) window = 2 * window + APIntModBit(exponent, b);
+
+        if (!started)
+        {
+            memcpy(result, table[window >> 1], n * sizeof(u_int64_t));
+            started = 1;
+        }
+        else
+        {
+            for (u_int64_t b = j; b <= i; b++) APIntModMulLimbs(result, result, result, ctx);
+            APIntModMulLimbs(result, result, table[window >> 1], ctx);
+        }
+        i = j;
+    }
+
+    APIntModFromMont(result, result, ctx);
+    APIntModStore(result, n, apint_result);
+    APIntArenaRestore(mark);
+}
@@ -0,0 +1,321 @@
+#include "APIntLimbs.h"
+#include <string.h>
+
+/* Subquadratic multiplication tiers built on the schoolbook kernel. Every tier works on
+ * raw limb arrays and takes its temporaries from a caller supplied scratch area, so a
+ * whole recursion draws a single block from the scratch arena in `APIntMult`. */
+
+size_t APIntThresholds[APINT_THRESHOLD_COUNT] = {
+    APINT_KARATSUBA_THRESHOLD,
+    APINT_TOOM3_THRESHOLD,
+    APINT_NTT_THRESHOLD,
+    APINT_PARALLEL_THRESHOLD,
+    APINT_DIVIDE_THRESHOLD,
+};
+
+// smallest legal value of each threshold; below it the tier cannot split its operands
+static const size_t APIntThresholdMinimum[APINT_THRESHOLD_COUNT] = {
+    2,  // Karatsuba needs a non-empty low half
+    5,  // Toom-3 needs a non-empty top third
+    1,  // the NTT takes any size
+    1,  // so does the thread pool
+    2,  // division splits the quotient in halves
+};
+
+void APIntSetThreshold(APIntThreshold threshold, size_t limbs)
+{
+    if (threshold >= APINT_THRESHOLD_COUNT) return;
+
+    if (limbs < APIntThresholdMinimum[threshold]) limbs = APIntThresholdMinimum[threshold];
+    APIntThresholds[threshold] = limbs;
+}
+
+size_t APIntGetThreshold(APIntThreshold threshold)
+{
+    return (threshold < APINT_THRESHOLD_COUNT) ? APIntThresholds[threshold] : 0;
+}
+
+
+// ### HELPERS
+
+// rp[0, rn) += xp[0, xn); the sum is known to fit, so leftover carry is impossible.
+static void APIntLimbsAddInto(u_int64_t *rp, size_t rn, const u_int64_t *xp, size_t xn)
+{
+    xn = APIntSignificantLimbs(xp, xn);
+    APIntLimbsAdd(rp, rp, rn, xp, xn);
+}
+
+// rp[0, n) = |ap[0, an) - bp[0, bn)| zero-extended to n limbs; returns 1 if a < b.
+static int APIntLimbsAbsDiff(u_int64_t *rp, const u_int64_t *ap, size_t an,
+                             const u_int64_t *bp, size_t bn, size_t n)
+{
+    int negative = (APIntLimbsCmp(ap, an, bp, bn) < 0);
+    if (negative)
+    {
+        const u_int64_t *tp = ap; ap = bp; bp = tp;
+        size_t tn = an; an = bn; bn = tn;
+    }
+
+    // the larger value never has fewer significant limbs than the smaller one
+    an = APIntSignificantLimbs(ap, an);
+    bn = APIntSignificantLimbs(bp, bn);
+    APIntLimbsSub(rp, ap, an, bp, bn);
+    memset(rp + an, 0, (n - an) * sizeof(u_int64_t));
+
+    return negative;
+}
+
+// xp[0, n) >>= 1
+static void APIntLimbsRShift1(u_int64_t *xp, size_t n)
+{
+    for (size_t i = 0; i + 1 < n; i++)
+    {
+        xp[i] = (xp[i] >> 1) | (xp[i + 1] << (APINT_LIMB_BITS - 1));
+    }
+    xp[n - 1] >>= 1;
+}
+
+// xp[0, n) /= 3 where the division is known to be exact.
+static void APIntLimbsDivExact3(u_int64_t *xp, size_t n)
+{
+    // multiply by the inverse of 3 modulo 2^64, tracking how far each quotient limb
+    // overshoots its dividend limb as a borrow into the next one
+    const u_int64_t inverse3 = 0xAAAAAAAAAAAAAAABULL;
+    u_int64_t borrow = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        u_int64_t limb = xp[i] - borrow;
+        borrow = (xp[i] < borrow) ? 1 : 0;
+
+        u_int64_t q = limb * inverse3;
+        xp[i] = q;
+        borrow += (q > 0x5555555555555555ULL) + (q > 0xAAAAAAAAAAAAAAAAULL);
+    }
+}
+
+
+// ### BALANCED TIERS
+
+static void APIntLimbsMulN(u_int64_t *rp, const u_int64_t *ap, const u_int64_t *bp, size_t n,
+                           u_int64_t *scratch);
+
+// Limbs of scratch any balanced product of n limbs may use. A level of Karatsuba takes
+// 6*ceil(m/2) + 1 limbs and recurses on ceil(m/2); a level of Toom-3 takes 10*(k + 1)
+// for k = ceil(m/3) and recurses on k + 1. Either way a level's own limbs plus 6 times
+// its recursion size stay below 6m + 32, so the sum stays below 6n plus 32 per level
+// over at most 64 levels.
+static size_t APIntLimbsMulNScratch(size_t n)
+{
+    if (n < APIntThresholds[APINT_THRESHOLD_KARATSUBA]) return 0;
+    return 6 * n + 32 * 64;
+}
+
+// Karatsuba: with a = a1*B^h + a0 and b = b1*B^h + b0,
+// a*b = z2*B^2h + (z0 + z2 - (a0 - a1)(b0 - b1))*B^h + z0.
+static void APIntLimbsMulKaratsuba(u_int64_t *rp, const u_int64_t *ap, const u_int64_t *bp, size_t n,
+                                   u_int64_t *scratch)
+{
+    size_t h = n / 2;
+    size_t nh = n - h;  // upper halves are never shorter than lower halves
+
+    u_int64_t *diffA = scratch;
+    u_int64_t *diffB = diffA + nh;
+    u_int64_t *diffProd = diffB + nh;
+    u_int64_t *middle = diffProd + 2 * nh;
+    u_int64_t *next = middle + 2 * nh + 1;
+
+    // squaring needs one difference only, and its square is never negative
+    int square = (ap == bp);
+    int negA = APIntLimbsAbsDiff(diffA, ap, h, ap + h, nh, nh);
+    int negB = square ? negA : APIntLimbsAbsDiff(diffB, bp, h, bp + h, nh, nh);
+    APIntLimbsMulN(diffProd, diffA, square ? diffA : diffB, nh, next);
+
+    // z0 and z2 land directly in their final place
+    APIntLimbsMulN(rp, ap, bp, h, next);
+    APIntLimbsMulN(rp + 2 * h, ap + h, bp + h, nh, next);
+
+    // middle = z0 + z2 -/+ |a0 - a1| * |b0 - b1|; always non-negative
+    middle[2 * nh] = APIntLimbsAdd(middle, rp + 2 * h, 2 * nh, rp, 2 * h);
+    if (negA == negB)
+        APIntLimbsSub(middle, middle, 2 * nh + 1, diffProd, 2 * nh);
+    else
+        APIntLimbsAdd(middle, middle, 2 * nh + 1, diffProd, 2 * nh);
+
+    APIntLimbsAddInto(rp + h, 2 * n - h, middle, 2 * nh + 1);
+}
+
+// Toom-3: split into thirds, evaluate at 0, 1, -1, 2 and infinity, multiply pointwise
+// and interpolate the five coefficients c0..c4 of the product polynomial.
+static void APIntLimbsMulToom3(u_int64_t *rp, const u_int64_t *ap, const u_int64_t *bp, size_t n,
+                               u_int64_t *scratch)
+{
+    size_t k = (n + 2) / 3;
+    size_t r = n - 2 * k;   // top third; at least one limb for n >= 5
+    size_t evalLen = k + 1;
+    size_t valLen = 2 * evalLen;
+
+    const u_int64_t *a0 = ap, *a1 = ap + k, *a2 = ap + 2 * k;
+    const u_int64_t *b0 = bp, *b1 = bp + k, *b2 = bp + 2 * k;
+
+    u_int64_t *sumA = scratch;          // a0 + a2, later scratch for interpolation
+    u_int64_t *sumB = sumA + evalLen;
+    u_int64_t *evalA = sumB + evalLen;
+    u_int64_t *evalB = evalA + evalLen;
+    u_int64_t *v1 = evalB + evalLen;
+    u_int64_t *vm1 = v1 + valLen;
+    u_int64_t *v2 = vm1 + valLen;
+    u_int64_t *next = v2 + valLen;
+
+    // squaring evaluates a single operand and squares every point
+    int square = (ap == bp);
+    int operands = square ? 1 : 2;
+    u_int64_t *evalSecond = square ? evalA : evalB;
+
+    sumA[k] = APIntLimbsAdd(sumA, a0, k, a2, r);
+    if (!square) sumB[k] = APIntLimbsAdd(sumB, b0, k, b2, r);
+
+    // v1 = a(1) * b(1)
+    APIntLimbsAdd(evalA, sumA, evalLen, a1, k);
+    if (!square) APIntLimbsAdd(evalB, sumB, evalLen, b1, k);
+    APIntLimbsMulN(v1, evalA, evalSecond, evalLen, next);
+
+    // |vm1| = |a(-1)| * |b(-1)|
+    int negVm1 = APIntLimbsAbsDiff(evalA, sumA, evalLen, a1, k, evalLen);
+    if (square)
+        negVm1 = 0;
+    else
+        negVm1 ^= APIntLimbsAbsDiff(evalB, sumB, evalLen, b1, k, evalLen);
+    APIntLimbsMulN(vm1, evalA, evalSecond, evalLen, next);
+
+    // v2 = a(2) * b(2), with a(2) = a0 + 2*a1 + 4*a2
+    const u_int64_t *parts[2][3] = {{a0, a1, a2}, {b0, b1, b2}};
+    u_int64_t *evals[2] = {evalA, evalB};
+    for (int j = 0; j < operands; j++)
+    {
+        u_int64_t *ep = evals[j];
+        memcpy(ep, parts[j][0], k * sizeof(u_int64_t));
+        ep[k] = APIntLimbsAddMul1(ep, parts[j][1], k, 2);
+        u_int64_t carry = APIntLimbsAddMul1(ep, parts[j][2], r, 4);
+        for (size_t i = r; carry && i < evalLen; i++)
+        {
+            ep[i] += carry;
+            carry = (ep[i] < carry) ? 1 : 0;
+        }
+    }
+    APIntLimbsMulN(v2, evalA, evalSecond, evalLen, next);
+
+    // c0 = v0 and c4 = vinf go straight to their final place
+    APIntLimbsMulN(rp, a0, b0, k, next);
+    APIntLimbsMulN(rp + 4 * k, a2, b2, r, next);
+    const u_int64_t *v0 = rp, *vinf = rp + 4 * k;
+
+    // odd = (v1 - vm1)/2 = c1 + c3 and even = (v1 + vm1)/2 = c0 + c2 + c4
+    u_int64_t *total = sumA;    // sumA and sumB are contiguous, valLen limbs
+    APIntLimbsAddN(total, v1, vm1, valLen);
+    APIntLimbsSubN(vm1, v1, vm1, valLen);
+    u_int64_t *odd = negVm1 ? total : vm1;
+    u_int64_t *even = negVm1 ? vm1 : total;
+    u_int64_t *spare = v1;
+    APIntLimbsRShift1(odd, valLen);
+    APIntLimbsRShift1(even, valLen);
+
+    // c2 = even - c0 - c4
+    APIntLimbsSub(even, even, valLen, v0, 2 * k);
+    APIntLimbsSub(even, even, valLen, vinf, 2 * r);
+
+    // c1 + 4*c3 = (v2 - c0 - 4*c2 - 16*c4) / 2
+    APIntLimbsSub(v2, v2, valLen, v0, 2 * k);
+    APIntLimbsMul1(spare, even, valLen, 4);
+    APIntLimbsSubN(v2, v2, spare, valLen);
+    spare[2 * r] = APIntLimbsMul1(spare, vinf, 2 * r, 16);
+    APIntLimbsSub(v2, v2, valLen, spare, 2 * r + 1);
+    APIntLimbsRShift1(v2, valLen);
+
+    // c3 = ((c1 + 4*c3) - (c1 + c3)) / 3, then c1 = (c1 + c3) - c3
+    APIntLimbsSubN(v2, v2, odd, valLen);
+    APIntLimbsDivExact3(v2, valLen);
+    APIntLimbsSubN(odd, odd, v2, valLen);
+
+    // recompose around c0 and c4
+    memset(rp + 2 * k, 0, 2 * k * sizeof(u_int64_t));
+    APIntLimbsAddInto(rp + k, 2 * n - k, odd, valLen);
+    APIntLimbsAddInto(rp + 2 * k, 2 * n - 2 * k, even, valLen);
+    APIntLimbsAddInto(rp + 3 * k, 2 * n - 3 * k, v2, valLen);
+}
+
+// Balanced product rp[0, 2n) = ap[0, n) * bp[0, n), dispatching on the tier thresholds;
+// ap == bp squares.
+static void APIntLimbsMulN(u_int64_t *rp, const u_int64_t *ap, const u_int64_t *bp, size_t n,
+                           u_int64_t *scratch)
+{
+    if (n < APIntThresholds[APINT_THRESHOLD_KARATSUBA] && ap == bp)
+        APIntLimbsSqrBasecase(rp, ap, n);
+    else if (n < APIntThresholds[APINT_THRESHOLD_KARATSUBA])
+        APIntLimbsMulBasecase(rp, ap, n, bp, n);
+    else if (n < APIntThresholds[APINT_THRESHOLD_TOOM3])
+        APIntLimbsMulKaratsuba(rp, ap, bp, n, scratch);
+    else
+        APIntLimbsMulToom3(rp, ap, bp, n, scratch);
+}
+
+
+// ### UNBALANCED DISPATCH
+
+// whether a product is large enough, and small enough, for the NTT tier
+static int APIntLimbsUseNTT(size_t an, size_t bn)
+{
+    return bn >= APIntThresholds[APINT_THRESHOLD_NTT] && APIntLimbsMulNTTFits(an, bn);
+}
+
+size_t APIntLimbsMulScratch(size_t an, size_t bn)
+{
+    if (APIntLimbsUseNTT(an, bn)) return APIntLimbsMulNTTScratch(an, bn);
+    if (bn < APIntThresholds[APINT_THRESHOLD_KARATSUBA]) return 0;
+    if (an == bn) return APIntLimbsMulNScratch(bn);
+
+    // a chunk product plus its own scratch, or the leftover product plus its recursion
+    size_t chunkNeed = 2 * bn + APIntLimbsMulNScratch(bn);
+    size_t rem = an % bn;
+    size_t remNeed = (rem == 0) ? 0 : bn + rem + APIntLimbsMulScratch(bn, rem);
+    return (chunkNeed > remNeed) ? chunkNeed : remNeed;
+}
+
+void APIntLimbsMul(u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn,
+                   u_int64_t *scratch)
+{
+    if (APIntLimbsUseNTT(an, bn))
+    {
+        APIntLimbsMulNTT(rp, ap, an, bp, bn, scratch);
+        return;
+    }
+    if (an == bn)
+    {
+        APIntLimbsMulN(rp, ap, bp, bn, scratch);
+        return;
+    }
+    if (bn < APIntThresholds[APINT_THRESHOLD_KARATSUBA])
+    {
+        APIntLimbsMulBasecase(rp, ap, an, bp, bn);
+        return;
+    }
+
+    // cut the longer factor into bn-limb chunks, each a balanced product, and add them
+    // up at their offsets; a shorter leftover chunk recurses with the roles swapped
+    APIntLimbsMulN(rp, ap, bp, bn, scratch);
+    u_int64_t *chunkProd = scratch;
+    size_t i;
+    for (i = bn; i + bn <= an; i += bn)
+    {
+        APIntLimbsMulN(chunkProd, ap + i, bp, bn, scratch + 2 * bn);
+        memcpy(rp + i + bn, chunkProd + bn, bn * sizeof(u_int64_t));
+        APIntLimbsAdd(rp + i, rp + i, 2 * bn, chunkProd, bn);
+    }
+
+    size_t rem = an - i;
+    if (rem > 0)
+    {
+        APIntLimbsMul(chunkProd, bp, bn, ap + i, rem, scratch + bn + rem);
+        memcpy(rp + i + bn, chunkProd + bn, rem * sizeof(u_int64_t));
+        APIntLimbsAdd(rp + i, rp + i, bn + rem, chunkProd, bn);
+    }
+}
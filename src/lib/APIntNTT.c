@@ -0,0 +1,409 @@
+#include "APIntLimbs.h"
+#include <string.h>
+
+/* Number theoretic transform multiplication for very large operands. Each factor is
+ * cut into 32-bit coefficients and convolved modulo three NTT-friendly primes; the
+ * exact convolution is recovered by CRT (Garner) and carried back into limbs. The
+ * primes multiply to more than 2^95, which covers every coefficient of a transform of
+ * up to 2^27 points, so results are exact. With the thread pool on, the three primes
+ * convolve side by side, each transform is cut into pieces, and the CRT runs in chunks
+ * whose carries are added afterwards; every piece computes exactly what the serial code
+ * would, so the product is the same. */
+
+// NTT prime p = c*2^k + 1 with its Montgomery constants
+typedef struct APIntNTTPrime {
+    u_int32_t p;
+    u_int32_t generator;    // primitive root modulo p
+    u_int32_t pinv;         // p^-1 mod 2^32
+    u_int32_t r2;           // 2^64 mod p, moves values into Montgomery form
+} APIntNTTPrime;
+
+// largest transform every prime supports (3892314113 = 29*2^27 + 1)
+#define APINT_NTT_MAX_LOG 27
+
+// 32-bit coefficients per limb
+#define APINT_NTT_COEFFS 2
+
+// Montgomery constants are fixed, so the table is read-only and safe to share between
+// threads; the compiler also turns reductions by these primes into multiplications.
+static const APIntNTTPrime APIntNTTPrimes[3] = {
+    {3221225473u, 5, 0x40000001u, 1789569709u},     // 3*2^30 + 1
+    {3489660929u, 3, 0x30000001u, 1961643719u},     // 13*2^28 + 1
+    {3892314113u, 3, 0x18000001u, 1703176688u},     // 29*2^27 + 1
+};
+
+
+// ### MODULAR ARITHMETIC
+
+// Residues are uniformly random, so the reductions below use masks instead of branches
+// the predictor would miss half the time.
+
+// (a - b) mod p for a, b < p
+static inline u_int32_t APIntNTTSub(u_int32_t a, u_int32_t b, u_int32_t p)
+{
+    u_int64_t d = (u_int64_t)a - b;
+    return (u_int32_t)d + (p & (u_int32_t)(d >> 32));
+}
+
+// (a + b) mod p for a, b < p
+static inline u_int32_t APIntNTTAdd(u_int32_t a, u_int32_t b, u_int32_t p)
+{
+    u_int64_t d = (u_int64_t)a + b - p;
+    return (u_int32_t)d + (p & (u_int32_t)(d >> 32));
+}
+
+// Montgomery product a*b/2^32 mod p for a, b < p.
+static inline u_int32_t APIntNTTMulMont(u_int32_t a, u_int32_t b, APIntNTTPrime prime)
+{
+    u_int64_t t = (u_int64_t)a * b;
+    u_int32_t m = (u_int32_t)t * prime.pinv;
+
+    // t and m*p agree on their low half, so only the high halves need subtracting
+    u_int32_t hi = (u_int32_t)(t >> 32);
+    u_int32_t mp = (u_int32_t)(((u_int64_t)m * prime.p) >> 32);
+    return APIntNTTSub(hi, mp, prime.p);
+}
+
+static inline u_int32_t APIntNTTToMont(u_int32_t a, APIntNTTPrime prime)
+{
+    return APIntNTTMulMont(a, prime.r2, prime);
+}
+
+
+// base^e mod p in plain (non-Montgomery) form
+static u_int32_t APIntNTTPowMod(u_int32_t base, u_int64_t e, u_int32_t p)
+{
+    u_int64_t result = 1, b = base % p;
+    while (e > 0)
+    {
+        if (e & 1) result = result * b % p;
+        b = b * b % p;
+        e >>= 1;
+    }
+    return (u_int32_t)result;
+}
+
+
+// ### TRANSFORMS
+
+// Twiddle table for a transform of n points: roots[m + j] = w_2m^j for every half
+// size m, so each butterfly level reads its roots contiguously. Stored in Montgomery
+// form; `inverse` selects the inverse roots.
+static void APIntNTTRoots(u_int32_t *roots, size_t n, int inverse, APIntNTTPrime prime)
+{
+    for (size_t m = 1; m < n; m <<= 1)
+    {
+        u_int32_t w = APIntNTTPowMod(prime.generator, (prime.p - 1) / (2 * m), prime.p);
+        if (inverse) w = APIntNTTPowMod(w, prime.p - 2, prime.p);
+
+        u_int32_t wMont = APIntNTTToMont(w, prime);
+        roots[m] = APIntNTTToMont(1, prime);
+        for (size_t j = 1; j < m; j++)
+        {
+            roots[m + j] = APIntNTTMulMont(roots[m + j - 1], wMont, prime);
+        }
+    }
+}
+
+// Forward butterflies j in [j, stop) between lo[j] and hi[j] with twiddles w[j].
+static inline void APIntNTTForwardButterflies(u_int32_t *lo, u_int32_t *hi, const u_int32_t *w,
+                                              size_t j, size_t stop, APIntNTTPrime prime)
+{
+    u_int32_t p = prime.p;
+    for (; j < stop; j++)
+    {
+        u_int32_t u = lo[j], v = hi[j];
+        lo[j] = APIntNTTAdd(u, v, p);
+        hi[j] = APIntNTTMulMont(APIntNTTSub(u, v, p), w[j], prime);
+    }
+}
+
+// Inverse butterflies j in [j, stop) between lo[j] and hi[j] with twiddles w[j].
+static inline void APIntNTTInverseButterflies(u_int32_t *lo, u_int32_t *hi, const u_int32_t *w,
+                                              size_t j, size_t stop, APIntNTTPrime prime)
+{
+    u_int32_t p = prime.p;
+    for (; j < stop; j++)
+    {
+        u_int32_t u = lo[j];
+        u_int32_t v = APIntNTTMulMont(hi[j], w[j], prime);
+        lo[j] = APIntNTTAdd(u, v, p);
+        hi[j] = APIntNTTSub(u, v, p);
+    }
+}
+
+// Decimation-in-frequency forward transform; leaves the output in bit reversed order.
+static void APIntNTTForward(u_int32_t *a, size_t n, const u_int32_t *roots, APIntNTTPrime prime)
+{
+    for (size_t m = n >> 1; m >= 1; m >>= 1)
+    {
+        for (size_t s = 0; s < n; s += 2 * m)
+        {
+            APIntNTTForwardButterflies(a + s, a + s + m, roots + m, 0, m, prime);
+        }
+    }
+}
+
+// Decimation-in-time inverse transform; takes bit reversed input, returns natural order
+// without the 1/n scaling.
+static void APIntNTTInverse(u_int32_t *a, size_t n, const u_int32_t *roots, APIntNTTPrime prime)
+{
+    for (size_t m = 1; m < n; m <<= 1)
+    {
+        for (size_t s = 0; s < n; s += 2 * m)
+        {
+            APIntNTTInverseButterflies(a + s, a + s + m, roots + m, 0, m, prime);
+        }
+    }
+}
+
+// Butterflies [first, last) of the level with half size m, in either direction.
+// Butterfly b pairs points 2m*(b/m) + b%m and m past it.
+static void APIntNTTLevel(u_int32_t *a, size_t m, size_t first, size_t last,
+                          const u_int32_t *roots, APIntNTTPrime prime, int inverse)
+{
+    while (first < last)
+    {
+        size_t j = first % m, block = first - j;
+        size_t stop = (last - block < m) ? last - block : m;
+        u_int32_t *lo = a + 2 * block;
+        if (inverse)
+            APIntNTTInverseButterflies(lo, lo + m, roots + m, j, stop, prime);
+        else
+            APIntNTTForwardButterflies(lo, lo + m, roots + m, j, stop, prime);
+        first = block + stop;
+    }
+}
+
+// a transform cut into `parts` pieces for the thread pool
+typedef struct APIntNTTSplit {
+    u_int32_t *a;
+    size_t n;
+    size_t m;               // half size of the level being split
+    const u_int32_t *roots;
+    APIntNTTPrime prime;
+    size_t parts;
+    int inverse;
+} APIntNTTSplit;
+
+// piece `part` of one level: an equal share of its butterflies
+static void APIntNTTLevelTask(void *arg, size_t part)
+{
+    APIntNTTSplit *split = (APIntNTTSplit*)arg;
+    size_t share = (split->n >> 1) / split->parts;
+    APIntNTTLevel(split->a, split->m, part * share, (part + 1) * share, split->roots, split->prime, split->inverse);
+}
+
+// piece `part` of the lower levels: a whole transform of n/parts points
+static void APIntNTTBlockTask(void *arg, size_t part)
+{
+    APIntNTTSplit *split = (APIntNTTSplit*)arg;
+    size_t points = split->n / split->parts;
+    if (split->inverse)
+        APIntNTTInverse(split->a + part * points, points, split->roots, split->prime);
+    else
+        APIntNTTForward(split->a + part * points, points, split->roots, split->prime);
+}
+
+// Forward or inverse transform in `parts` pieces, a power of two dividing n. Levels that
+// span more than n/parts points are shared out by butterflies, one group per level;
+// below them each block of n/parts points transforms on its own. Every butterfly is the
+// one the serial transform computes, so the output is identical.
+static void APIntNTTTransform(u_int32_t *a, size_t n, const u_int32_t *roots, APIntNTTPrime prime,
+                              int inverse, size_t parts)
+{
+    if (parts <= 1)
+    {
+        if (inverse)
+            APIntNTTInverse(a, n, roots, prime);
+        else
+            APIntNTTForward(a, n, roots, prime);
+        return;
+    }
+
+    APIntNTTSplit split = {a, n, 0, roots, prime, parts, inverse};
+    if (inverse)
+    {
+        APIntParallelRun(APIntNTTBlockTask, &split, parts);
+        for (split.m = n / parts; split.m < n; split.m <<= 1) APIntParallelRun(APIntNTTLevelTask, &split, parts);
+    }
+    else
+    {
+        for (split.m = n >> 1; split.m >= n / parts; split.m >>= 1) APIntParallelRun(APIntNTTLevelTask, &split, parts);
+        APIntParallelRun(APIntNTTBlockTask, &split, parts);
+    }
+}
+
+// Split xp[0, xn) into 32-bit coefficients reduced mod p, zero padded to n points.
+static void APIntNTTLoad(u_int32_t *f, size_t n, const u_int64_t *xp, size_t xn, u_int32_t p)
+{
+    for (size_t i = 0; i < xn; i++)
+    {
+        u_int32_t lo = (u_int32_t)xp[i], hi = (u_int32_t)(xp[i] >> 32);
+        f[2 * i] = (lo >= p) ? lo - p : lo;
+        f[2 * i + 1] = (hi >= p) ? hi - p : hi;
+    }
+    memset(f + APINT_NTT_COEFFS * xn, 0, (n - APINT_NTT_COEFFS * xn) * sizeof(u_int32_t));
+}
+
+// transform length for a product of an + bn limbs
+static size_t APIntNTTLength(size_t an, size_t bn)
+{
+    size_t n = 1;
+    while (n < APINT_NTT_COEFFS * (an + bn)) n <<= 1;
+    return n;
+}
+
+
+// ### CONVOLUTION AND RECOMBINATION
+
+// smallest piece a transform is cut into for the thread pool, in points
+#define APINT_NTT_MIN_PIECE 4096
+
+// one product: the factors, a residue vector per prime, and how far to split the work
+typedef struct APIntNTTJob {
+    const u_int64_t *ap;
+    size_t an;
+    const u_int64_t *bp;
+    size_t bn;
+    size_t n;
+    u_int32_t *residues[3];
+    u_int64_t *rp;
+    size_t parts;           // transform pieces, a power of two
+    size_t chunk;           // coefficients recombined per CRT task, even
+    u_int64_t *carries;     // two limbs carried out of each CRT task
+} APIntNTTJob;
+
+// Cyclic convolution modulo prime k into residues[k]; the twiddle table and second
+// operand come from the running thread's arena.
+static void APIntNTTConvolve(void *arg, size_t k)
+{
+    APIntNTTJob *job = (APIntNTTJob*)arg;
+    APIntNTTPrime prime = APIntNTTPrimes[k];
+    size_t n = job->n;
+    u_int32_t *fa = job->residues[k];
+
+    APIntArenaMark mark = APIntArenaSave();
+    u_int32_t *fb = (u_int32_t*)APIntArenaAlloc(n);     // n limbs: n words each for fb and roots
+    u_int32_t *roots = fb + n;
+
+    APIntNTTRoots(roots, n, 0, prime);
+    APIntNTTLoad(fa, n, job->ap, job->an, prime.p);
+    APIntNTTTransform(fa, n, roots, prime, 0, job->parts);
+    if (job->bp == job->ap && job->bn == job->an)   // squaring transforms once
+    {
+        for (size_t i = 0; i < n; i++) fa[i] = APIntNTTMulMont(fa[i], fa[i], prime);
+    }
+    else
+    {
+        APIntNTTLoad(fb, n, job->bp, job->bn, prime.p);
+        APIntNTTTransform(fb, n, roots, prime, 0, job->parts);
+        for (size_t i = 0; i < n; i++) fa[i] = APIntNTTMulMont(fa[i], fb[i], prime);
+    }
+
+    // pointwise products carry an extra 2^-32 that the 1/n scaling takes back out
+    APIntNTTRoots(roots, n, 1, prime);
+    APIntNTTTransform(fa, n, roots, prime, 1, job->parts);
+    u_int32_t nInv = APIntNTTPowMod((u_int32_t)(n % prime.p), prime.p - 2, prime.p);
+    u_int32_t scale = APIntNTTToMont(APIntNTTToMont(nInv, prime), prime);
+    for (size_t i = 0; i < n; i++) fa[i] = APIntNTTMulMont(fa[i], scale, prime);
+
+    APIntArenaRestore(mark);
+}
+
+// Garner's CRT over coefficients [first, last), first even: x = r0 + p0*(v1 + p1*v2),
+// carried 32 bits at a time into rp as if the range began at bit 0 of limb first/2.
+// Returns what is carried out of the top.
+static u_int128_t APIntNTTGarner(u_int64_t *rp, u_int32_t *const residues[3], size_t first, size_t last)
+{
+    const u_int64_t p0 = APIntNTTPrimes[0].p, p1 = APIntNTTPrimes[1].p, p2 = APIntNTTPrimes[2].p;
+    const u_int64_t p0Inv1 = APIntNTTPowMod((u_int32_t)(p0 % p1), p1 - 2, (u_int32_t)p1);
+    const u_int64_t p01Inv2 = APIntNTTPowMod((u_int32_t)(p0 * p1 % p2), p2 - 2, (u_int32_t)p2);
+
+    u_int128_t carry = 0;
+    for (size_t i = first; i < last; i++)
+    {
+        u_int64_t r0 = residues[0][i], r1 = residues[1][i], r2 = residues[2][i];
+        u_int64_t v1 = (r1 + p1 - r0 % p1) % p1 * p0Inv1 % p1;
+        u_int64_t x01 = r0 + p0 * v1;   // below p0*p1 < 2^64
+        u_int64_t v2 = (r2 + p2 - x01 % p2) % p2 * p01Inv2 % p2;
+
+        carry += (u_int128_t)x01 + (u_int128_t)(p0 * p1) * v2;
+        u_int32_t word = (u_int32_t)carry;
+        carry >>= 32;
+
+        if (i % 2 == 0)
+            rp[i / 2] = word;
+        else
+            rp[i / 2] |= (u_int64_t)word << 32;
+    }
+    return carry;
+}
+
+// CRT task `c`: one chunk of coefficients, its carry kept for the serial fix-up
+static void APIntNTTGarnerTask(void *arg, size_t c)
+{
+    APIntNTTJob *job = (APIntNTTJob*)arg;
+    size_t coeffs = APINT_NTT_COEFFS * (job->an + job->bn);
+    size_t first = c * job->chunk;
+    size_t last = (coeffs - first < job->chunk) ? coeffs : first + job->chunk;
+
+    u_int128_t carry = APIntNTTGarner(job->rp, job->residues, first, last);
+    job->carries[2 * c] = (u_int64_t)carry;
+    job->carries[2 * c + 1] = (u_int64_t)(carry >> APINT_LIMB_BITS);
+}
+
+
+// ### PRODUCT
+
+int APIntLimbsMulNTTFits(size_t an, size_t bn)
+{
+    return APINT_NTT_COEFFS * (an + bn) <= ((size_t)1 << APINT_NTT_MAX_LOG);
+}
+
+size_t APIntLimbsMulNTTScratch(size_t an, size_t bn)
+{
+    // the three residue vectors, as 32-bit words
+    size_t n = APIntNTTLength(an, bn);
+    return (3 * n + 1) / 2;
+}
+
+void APIntLimbsMulNTT(u_int64_t *rp, const u_int64_t *ap, size_t an, const u_int64_t *bp, size_t bn,
+                      u_int64_t *scratch)
+{
+    size_t n = APIntNTTLength(an, bn);
+    size_t rn = an + bn;
+    size_t threads = APIntParallelThreads(bn);
+
+    APIntNTTJob job = {ap, an, bp, bn, n, {NULL, NULL, NULL}, rp, 1, APINT_NTT_COEFFS * rn, NULL};
+    job.residues[0] = (u_int32_t*)scratch;
+    job.residues[1] = job.residues[0] + n;
+    job.residues[2] = job.residues[1] + n;
+
+    // with threads, the primes run side by side and every transform is cut into at
+    // least one piece per thread; the CRT takes an even chunk per thread
+    size_t chunks = 1;
+    if (threads > 1)
+    {
+        while (job.parts < threads && n / (2 * job.parts) >= APINT_NTT_MIN_PIECE) job.parts <<= 1;
+        job.chunk = APINT_NTT_COEFFS * ((rn + threads - 1) / threads);
+        chunks = (rn * APINT_NTT_COEFFS + job.chunk - 1) / job.chunk;
+    }
+
+    APIntArenaMark mark = APIntArenaSave();
+    job.carries = APIntArenaAlloc(2 * chunks);
+
+    APIntParallelRun(APIntNTTConvolve, &job, 3);
+    APIntParallelRun(APIntNTTGarnerTask, &job, chunks);
+
+    // each chunk's carry lands on the limbs above it; the product fits rp, so the last
+    // carry is zero and none runs past the top
+    for (size_t c = 0; c + 1 < chunks; c++)
+    {
+        size_t offset = (c + 1) * job.chunk / APINT_NTT_COEFFS;
+        size_t len = rn - offset;
+        APIntLimbsAdd(rp + offset, rp + offset, len, job.carries + 2 * c, (len < 2) ? len : 2);
+    }
+
+    APIntArenaRestore(mark);
+}
@@ -0,0 +1,405 @@
+#include "APIntLimbs.h"
+#include <string.h>
+
+/* Conversion to and from digits of any radix from 2 to 36. Powers of two map digits to
+ * bits directly. Other radices go a chunk at a time, a chunk being the most digits whose
+ * value fits a limb (19 for decimal): one limb multiply or division per chunk, which is
+ * quadratic. From a threshold on, a number is split around a power B^(2^i) of the chunk
+ * base instead, the halves converted on their own and joined (or separated) by one
+ * product (or division) through the fast multipliers. The powers are squared up once
+ * per thread and kept for the next conversion in the same radix. */
+
+// limbs from which parsing splits the digits instead of going a chunk at a time; a
+// chunk there costs a multiply-add per limb, so the quadratic loop stays ahead for long
+#define APINT_RADIX_GET_THRESHOLD 256
+
+// limbs from which printing splits the number; a chunk there costs a division per limb
+#define APINT_RADIX_PUT_THRESHOLD 32
+
+// powers B^(2^i) the table holds at most; far more than memory allows
+#define APINT_RADIX_LEVELS 48
+
+static const char APIntRadixDigits[36] = {
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h',
+    'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z'
+};
+
+// ceil(2^32 / log2(radix)) for radices 2 to 36: digits per bit, in 32.32 fixed point
+static const u_int64_t APIntRadixDigitsPerBit[35] = {
+    4294967296u, 2709822658u, 2147483648u, 1849741733u, 1661520156u, 1529898220u, 1431655766u,
+    1354911329u, 1292913987u, 1241523976u, 1198050830u, 1160664036u, 1128071164u, 1099331346u,
+    1073741824u, 1050766078u, 1029986702u, 1011073585u, 993761859u, 977836273u, 963119892u,
+    949465784u, 936750802u, 924870867u, 913737343u, 903274220u, 893415895u, 884105414u,
+    875293063u, 866935226u, 858993460u, 851433730u, 844225783u, 837342624u, 830760078u
+};
+
+// a radix with its chunk: `digits` digits make one limb of value below `base`
+typedef struct APIntRadixSpec {
+    unsigned radix;
+    unsigned digits;
+    u_int64_t base;
+    unsigned bits;      // bits per digit for powers of two, 0 otherwise
+} APIntRadixSpec;
+
+static APIntRadixSpec APIntRadixSpecOf(unsigned radix)
+{
+    if (radix < 2 || radix > 36)  // error check
+    {
+        fprintf(stderr, "Error: Radix conversion failed; radix must be from 2 to 36.\n");
+        exit(1);
+    }
+
+    APIntRadixSpec spec = {radix, 1, radix, 0};
+    while (spec.base <= ~(u_int64_t)0 / radix)
+    {
+        spec.base *= radix;
+        spec.digits++;
+    }
+    if ((radix & (radix - 1)) == 0) spec.bits = (unsigned)__builtin_ctz(radix);
+    return spec;
+}
+
+// most digits a number of `bits` bits can have in the radix
+static size_t APIntRadixDigitBound(size_t bits, unsigned radix)
+{
+    return (size_t)(((u_int128_t)bits * APIntRadixDigitsPerBit[radix - 2]) >> 32) + 1;
+}
+
+// Value of a digit character, letters in either case; digits are assumed valid.
+static inline unsigned APIntRadixDigitValue(char c)
+{
+    return (c <= '9') ? (unsigned)(c - '0') : (unsigned)((c | 0x20) - 'a' + 10);
+}
+
+
+// ### POWER TABLE
+
+// B^(2^i) for the chunk base B of one radix, per thread
+typedef struct APIntRadixPowers {
+    unsigned radix;     // 0 while empty
+    size_t levels;
+    u_int64_t *limbs[APINT_RADIX_LEVELS];
+    size_t size[APINT_RADIX_LEVELS];
+} APIntRadixPowers;
+
+static __thread APIntRadixPowers APIntThreadPowers;
+
+void APIntRadixRelease(void)
+{
+    APIntRadixPowers *powers = &APIntThreadPowers;
+    for (size_t i = 0; i < powers->levels; i++)
+    {
+        // each level was allocated at twice the size of the one below
+        APIntFree(powers->limbs[i], ((size_t)1 << i) * sizeof(u_int64_t));
+    }
+    powers->radix = 0;
+    powers->levels = 0;
+}
+
+// The table for spec's radix with at least `levels` levels, squared up as needed.
+static const APIntRadixPowers *APIntRadixPowersFor(const APIntRadixSpec *spec, size_t levels)
+{
+    APIntRadixPowers *powers = &APIntThreadPowers;
+    if (powers->radix != spec->radix) APIntRadixRelease();
+    powers->radix = spec->radix;
+
+    while (powers->levels < levels)
+    {
+        size_t i = powers->levels;
+        u_int64_t *limbs = (u_int64_t*)APIntMalloc(((size_t)1 << i) * sizeof(u_int64_t));
+        if (limbs == NULL)  // error check
+        {
+            fprintf(stderr, "Error: Radix conversion failed; could not allocate sufficient memory.\n");
+            exit(1);
+        }
+
+        if (i == 0)
+        {
+            limbs[0] = spec->base;
+            powers->size[0] = 1;
+        }
+        else
+        {
+            size_t n = powers->size[i - 1];
+            APIntArenaMark mark = APIntArenaSave();
+            size_t scratchSize = APIntLimbsMulScratch(n, n);
+            APIntLimbsMul(limbs, powers->limbs[i - 1], n, powers->limbs[i - 1], n,
+                          (scratchSize > 0) ? APIntArenaAlloc(scratchSize) : NULL);
+            APIntArenaRestore(mark);
+            powers->size[i] = APIntSignificantLimbs(limbs, 2 * n);
+        }
+        powers->limbs[i] = limbs;
+        powers->levels++;
+    }
+    return powers;
+}
+
+
+// ### PARSING
+
+// Value of the n <= spec->digits digits at p.
+static inline u_int64_t APIntRadixChunkValue(const char *p, size_t n, unsigned radix)
+{
+    u_int64_t value = 0;
+    for (size_t i = 0; i < n; i++) value = value * radix + APIntRadixDigitValue(p[i]);
+    return value;
+}
+
+// Value of len >= 1 digits into rp, which has room for a limb per started chunk; returns
+// its normalized size. Chunks are folded in from the top with one multiply each.
+static size_t APIntRadixGetBasecase(u_int64_t *rp, const char *digits, size_t len,
+                                    const APIntRadixSpec *spec)
+{
+    size_t first = (len % spec->digits == 0) ? spec->digits : len % spec->digits;
+    size_t n = 1;
+    rp[0] = APIntRadixChunkValue(digits, first, spec->radix);
+
+    for (size_t pos = first; pos < len; pos += spec->digits)
+    {
+        // decimal is spelled out so the inlined loop multiplies by a constant; keep both calls
+        u_int64_t carry = (spec->radix == 10) ? APIntRadixChunkValue(digits + pos, spec->digits, 10)
+                                              : APIntRadixChunkValue(digits + pos, spec->digits, spec->radix);
+        for (size_t i = 0; i < n; i++)
+        {
+            u_int128_t t = (u_int128_t)rp[i] * spec->base + carry;
+            rp[i] = (u_int64_t)t;
+            carry = (u_int64_t)(t >> APINT_LIMB_BITS);
+        }
+        if (carry != 0) rp[n++] = carry;
+    }
+    return APIntSignificantLimbs(rp, n);
+}
+
+// As above, splitting long runs of digits: the low half is a whole number of chunks
+// 2^i, so the value is high * B^(2^i) + low.
+static size_t APIntRadixGet(u_int64_t *rp, const char *digits, size_t len, const APIntRadixSpec *spec)
+{
+    if (len <= (size_t)spec->digits * APINT_RADIX_GET_THRESHOLD)
+        return APIntRadixGetBasecase(rp, digits, len, spec);
+
+    size_t level = 0;
+    while (level + 1 < APINT_RADIX_LEVELS && ((size_t)spec->digits << (level + 1)) < len) level++;
+    const APIntRadixPowers *powers = APIntRadixPowersFor(spec, level + 1);
+    const u_int64_t *pp = powers->limbs[level];
+    size_t pn = powers->size[level];
+
+    // the high part has a limb per chunk, the low part 2^i; so has rp beyond the high part
+    APIntArenaMark mark = APIntArenaSave();
+    size_t low = (size_t)spec->digits << level, high = len - low;
+    u_int64_t *hp = APIntArenaAlloc((high + spec->digits - 1) / spec->digits);
+    u_int64_t *lp = APIntArenaAlloc((size_t)1 << level);
+    size_t hn = APIntRadixGet(hp, digits, high, spec);
+    size_t ln = APIntRadixGet(lp, digits + high, low, spec);
+
+    // high * B^(2^i) + low < (high + 1) * B^(2^i), so the sum carries out of nothing
+    size_t scratchSize = APIntLimbsMulScratch((hn > pn) ? hn : pn, (hn > pn) ? pn : hn);
+    u_int64_t *scratch = (scratchSize > 0) ? APIntArenaAlloc(scratchSize) : NULL;
+    if (hn >= pn)
+        APIntLimbsMul(rp, hp, hn, pp, pn, scratch);
+    else
+        APIntLimbsMul(rp, pp, pn, hp, hn, scratch);
+    APIntLimbsAdd(rp, rp, hn + pn, lp, ln);
+    APIntArenaRestore(mark);
+    return APIntSignificantLimbs(rp, hn + pn);
+}
+
+// Power of two radix: each digit is `bits` bits, placed from the bottom.
+static void APIntRadixGetBits(u_int64_t *rp, size_t n, const char *digits, size_t len, unsigned bits)
+{
+    memset(rp, 0, n * sizeof(u_int64_t));
+    for (size_t j = 0; j < len; j++)
+    {
+        u_int64_t digit = APIntRadixDigitValue(digits[len - 1 - j]);
+        size_t bit = j * bits, limb = bit / APINT_LIMB_BITS, offset = bit % APINT_LIMB_BITS;
+        rp[limb] |= digit << offset;
+        if (offset + bits > APINT_LIMB_BITS) rp[limb + 1] |= digit >> (APINT_LIMB_BITS - offset);
+    }
+}
+
+void APIntFromRadix(const char *digits, size_t len, unsigned radix, APInt *apint)
+{
+    APIntRadixSpec spec = APIntRadixSpecOf(radix);
+
+    // leading zeros would only leave zero limbs on top
+    while (len > 0 && *digits == '0')
+    {
+        digits++;
+        len--;
+    }
+
+    // a limb per chunk, or per 64 bits of a power of two radix
+    size_t limbs = (spec.bits > 0) ? (len * spec.bits + APINT_LIMB_BITS - 1) / APINT_LIMB_BITS
+                                   : (len + spec.digits - 1) / spec.digits;
+    if (limbs == 0) limbs = 1;
+    if (APIntAllocLimbs(apint, limbs) == NULL)  // error check
+    {
+        fprintf(stderr, "Error: Radix to number failed; could not allocate sufficient memory.\n");
+        exit(1);
+    }
+
+    if (len == 0)
+    {
+        apint->limbs[0] = 0;
+        apint->size = 1;
+    }
+    else if (spec.bits > 0)
+    {
+        APIntRadixGetBits(apint->limbs, limbs, digits, len, spec.bits);
+        apint->size = APIntSignificantLimbs(apint->limbs, limbs);
+    }
+    else
+    {
+        apint->size = APIntRadixGet(apint->limbs, digits, len, &spec);
+    }
+}
+
+void APIntFromDecimal(const char *digits, size_t len, APInt *apint)
+{
+    APIntFromRadix(digits, len, 10, apint);
+}
+
+
+// ### PRINTING
+
+// The n digits of one chunk, zero padded, ending at end.
+static inline void APIntRadixChunkDigits(char *end, u_int64_t chunk, unsigned n, unsigned radix)
+{
+    for (unsigned i = 0; i < n; i++)
+    {
+        *--end = APIntRadixDigits[chunk % radix];
+        chunk /= radix;
+    }
+}
+
+// Write the digits of np[0, nn), which is destroyed, at out and return their end:
+// exactly `pad` digits, zero padded, or as many as a nonzero value needs if pad is 0.
+// Chunks come off the bottom by single-limb division, so they are written backwards
+// into scratch first.
+static char *APIntRadixPutBasecase(char *out, u_int64_t *np, size_t nn, size_t pad,
+                                   const APIntRadixSpec *spec)
+{
+    APIntArenaMark mark = APIntArenaSave();
+    size_t cap = APIntRadixDigitBound(nn * APINT_LIMB_BITS, spec->radix) + spec->digits;
+    char *end = (char*)APIntArenaAlloc((cap + sizeof(u_int64_t) - 1) / sizeof(u_int64_t)) + cap;
+    char *p = end;
+
+    while (nn > 1 || np[0] != 0)
+    {
+        u_int64_t chunk = APIntLimbsDivRem1(np, np, nn, spec->base);
+        nn = APIntSignificantLimbs(np, nn);
+        // spelled out for radix 10 so that, once inlined, dividing by the radix compiles to
+        // a multiplication rather than a division per digit
+        if (spec->radix == 10)
+            APIntRadixChunkDigits(p, chunk, spec->digits, 10);
+        else
+            APIntRadixChunkDigits(p, chunk, spec->digits, spec->radix);
+        p -= spec->digits;
+    }
+    while (p < end && *p == '0') p++;
+
+    size_t length = (size_t)(end - p);
+    if (pad > length)
+    {
+        memset(out, '0', pad - length);
+        out += pad - length;
+    }
+    memcpy(out, p, length);
+    APIntArenaRestore(mark);
+    return out + length;
+}
+
+// As above, splitting long numbers by B^(2^i) of about half their size: the quotient's
+// digits, then the remainder's, exactly digits * 2^i of them.
+static char *APIntRadixPut(char *out, u_int64_t *np, size_t nn, size_t pad, const APIntRadixSpec *spec)
+{
+    nn = APIntSignificantLimbs(np, nn);
+    if (nn < APINT_RADIX_PUT_THRESHOLD) return APIntRadixPutBasecase(out, np, nn, pad, spec);
+
+    // a level squares to at most twice its size, so the next is only built when it
+    // could still fit in half the number
+    const APIntRadixPowers *powers = APIntRadixPowersFor(spec, 1);
+    size_t level = 0;
+    while (level + 1 < APINT_RADIX_LEVELS && 2 * powers->size[level] - 1 <= nn / 2)
+    {
+        powers = APIntRadixPowersFor(spec, level + 2);
+        if (powers->size[level + 1] > nn / 2) break;
+        level++;
+    }
+    const u_int64_t *pp = powers->limbs[level];
+    size_t pn = powers->size[level];
+    size_t low = (size_t)spec->digits << level;
+
+    APIntArenaMark mark = APIntArenaSave();
+    u_int64_t *qp = APIntArenaAlloc(nn - pn + 1);
+    u_int64_t *rp = APIntArenaAlloc(pn);
+    APIntLimbsDivRem(qp, rp, np, nn, pp, pn);
+    out = APIntRadixPut(out, qp, nn - pn + 1, (pad > 0) ? pad - low : 0, spec);
+    out = APIntRadixPut(out, rp, pn, low, spec);
+    APIntArenaRestore(mark);
+    return out;
+}
+
+// Power of two radix: `bits` bits per digit, read off from the top.
+static size_t APIntRadixPutBits(const APInt *apint, char *out, unsigned bits)
+{
+    u_int64_t topLimb = apint->limbs[apint->size - 1];
+    size_t total = APINT_LIMB_BITS * (apint->size - 1) + (size_t)(APINT_LIMB_BITS - __builtin_clzll(topLimb));
+    size_t length = (total + bits - 1) / bits;
+    u_int64_t mask = ((u_int64_t)1 << bits) - 1;
+
+    for (size_t j = 0; j < length; j++)
+    {
+        size_t bit = j * bits, limb = bit / APINT_LIMB_BITS, offset = bit % APINT_LIMB_BITS;
+        u_int64_t digit = apint->limbs[limb] >> offset;
+        if (offset + bits > APINT_LIMB_BITS && limb + 1 < apint->size)
+            digit |= apint->limbs[limb + 1] << (APINT_LIMB_BITS - offset);
+        out[length - 1 - j] = APIntRadixDigits[digit & mask];
+    }
+    return length;
+}
+
+size_t APIntToRadix(const APInt *apint, unsigned radix, char *out, size_t cap)
+{
+    APIntRadixSpec spec = APIntRadixSpecOf(radix);
+    u_int64_t topLimb = apint->limbs[apint->size - 1];
+    if (apint->size == 1 && topLimb == 0)
+    {
+        if (cap >= 1) out[0] = '0';
+        return 1;
+    }
+
+    size_t bits = APINT_LIMB_BITS * (apint->size - 1) + (size_t)(APINT_LIMB_BITS - __builtin_clzll(topLimb));
+    size_t bound = APIntRadixDigitBound(bits, radix);
+    if (bound > cap) return bound;
+    if (spec.bits > 0) return APIntRadixPutBits(apint, out, spec.bits);
+
+    // the conversion consumes its input, so it works on a copy
+    APIntArenaMark mark = APIntArenaSave();
+    u_int64_t *np = APIntArenaAlloc(apint->size);
+    memcpy(np, apint->limbs, apint->size * sizeof(u_int64_t));
+    size_t length = (size_t)(APIntRadixPut(out, np, apint->size, 0, &spec) - out);
+    APIntArenaRestore(mark);
+    return length;
+}
+
+size_t APIntToDecimal(const APInt *apint, char *out, size_t cap)
+{
+    return APIntToRadix(apint, 10, out, cap);
+}
+
+void APIntPrintAsDecimal(const APInt *apint, FILE *stream)
+{
+    // the digits and a newline, written at once
+    size_t bound = APIntToDecimal(apint, NULL, 0);
+    char *decStr = (char*)APIntMalloc(bound + 1);
+    if (decStr == NULL)  // error check
+    {
+        fprintf(stderr, "Error: Print failed; could not allocate sufficient memory.\n");
+        exit(1);
+    }
+
+    size_t length = APIntToDecimal(apint, decStr, bound);
+    decStr[length] = '\n';
+    fwrite(decStr, 1, length + 1, stream);
+    APIntFree(decStr, bound + 1);
+}
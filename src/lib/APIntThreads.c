@@ -0,0 +1,130 @@
+#include "APIntLimbs.h"
+#include <pthread.h>
+
+/* Thread pool for spreading very large products across cores. Work is posted as groups
+ * of indexed tasks on one shared stack, newest group first. A thread waiting for its
+ * group keeps taking tasks, from its own group or any other, so nested groups cannot
+ * deadlock and threads only sleep when nothing is left to hand out. Each task draws its
+ * temporaries from the scratch arena of whichever thread runs it. */
+
+// most threads the pool runs, the calling thread included
+#define APINT_MAX_THREADS 256
+
+typedef struct APIntTaskGroup {
+    APIntTaskFn fn;
+    void *arg;
+    size_t next;                    // next index to hand out
+    size_t count;
+    size_t pending;                 // tasks not yet finished
+    struct APIntTaskGroup *below;   // group posted earlier
+} APIntTaskGroup;
+
+static pthread_mutex_t APIntPoolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t APIntPoolWake = PTHREAD_COND_INITIALIZER;    // tasks posted or a group done
+static APIntTaskGroup *APIntPoolTop = NULL;     // newest group with tasks left to hand out
+static int APIntPoolStop = 0;
+
+static pthread_t APIntPoolWorkers[APINT_MAX_THREADS];
+static size_t APIntPoolThreads = 1;
+
+// Hand out the next task of the newest group; the pool lock must be held.
+static int APIntPoolTake(APIntTaskGroup **group, size_t *index)
+{
+    APIntTaskGroup *top = APIntPoolTop;
+    if (top == NULL) return 0;
+
+    *group = top;
+    *index = top->next++;
+    if (top->next == top->count) APIntPoolTop = top->below;
+    return 1;
+}
+
+// Run a task outside the lock, then retire it; the pool lock is held before and after.
+static void APIntPoolRun(APIntTaskGroup *group, size_t index)
+{
+    pthread_mutex_unlock(&APIntPoolLock);
+    group->fn(group->arg, index);
+    pthread_mutex_lock(&APIntPoolLock);
+
+    if (--group->pending == 0) pthread_cond_broadcast(&APIntPoolWake);
+}
+
+static void *APIntPoolWorker(void *unused)
+{
+    (void)unused;
+    APIntTaskGroup *group;
+    size_t index;
+
+    pthread_mutex_lock(&APIntPoolLock);
+    while (!APIntPoolStop)
+    {
+        if (APIntPoolTake(&group, &index))
+            APIntPoolRun(group, index);
+        else
+            pthread_cond_wait(&APIntPoolWake, &APIntPoolLock);
+    }
+    pthread_mutex_unlock(&APIntPoolLock);
+
+    // the arena dies with the thread
+    APIntReleaseScratch();
+    return NULL;
+}
+
+void APIntSetThreads(size_t count)
+{
+    if (count < 1) count = 1;
+    if (count > APINT_MAX_THREADS) count = APINT_MAX_THREADS;
+
+    // retire the current workers, then start the new set
+    pthread_mutex_lock(&APIntPoolLock);
+    APIntPoolStop = 1;
+    pthread_cond_broadcast(&APIntPoolWake);
+    pthread_mutex_unlock(&APIntPoolLock);
+    for (size_t i = 0; i + 1 < APIntPoolThreads; i++) pthread_join(APIntPoolWorkers[i], NULL);
+    APIntPoolStop = 0;
+
+    // a worker that cannot be started only costs parallelism
+    size_t started = 0;
+    while (started + 1 < count && pthread_create(&APIntPoolWorkers[started], NULL, APIntPoolWorker, NULL) == 0)
+    {
+        started++;
+    }
+    APIntPoolThreads = started + 1;
+}
+
+size_t APIntGetThreads(void)
+{
+    return APIntPoolThreads;
+}
+
+size_t APIntParallelThreads(size_t limbs)
+{
+    return (limbs >= APIntThresholds[APINT_THRESHOLD_PARALLEL]) ? APIntPoolThreads : 1;
+}
+
+void APIntParallelRun(APIntTaskFn fn, void *arg, size_t count)
+{
+    if (APIntPoolThreads <= 1 || count <= 1)
+    {
+        for (size_t i = 0; i < count; i++) fn(arg, i);
+        return;
+    }
+
+    APIntTaskGroup group = {fn, arg, 0, count, count, NULL};
+    APIntTaskGroup *taken;
+    size_t index;
+
+    pthread_mutex_lock(&APIntPoolLock);
+    group.below = APIntPoolTop;
+    APIntPoolTop = &group;
+    pthread_cond_broadcast(&APIntPoolWake);
+
+    while (group.pending > 0)
+    {
+        if (APIntPoolTake(&taken, &index))
+            APIntPoolRun(taken, index);
+        else
+            pthread_cond_wait(&APIntPoolWake, &APIntPoolLock);
+    }
+    pthread_mutex_unlock(&APIntPoolLock);
+}
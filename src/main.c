@@ -1,20 +1,965 @@
 #include "APInt.h"
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
-#define MAX_LEN 256
+// bytes read at a time from input that cannot be mapped
+#define INPUT_BLOCK (1 << 20)
+
+// commands the scheduler reads ahead and runs as one dependency graph
+#define SCHEDULE_WINDOW 256
+
+// size of the DUMP output buffer; grows if a single value needs more
+#define DUMP_BUFF_LEN (1 << 20)
+
+// DUMP output buffer, kept between commands
+static char *dumpBuff = NULL;
+static size_t dumpBuffLen = 0;
 
 // HELPER FUNCTIONS (for cleaner `main`)
+// Make the DUMP output buffer hold at least `needed` bytes; its contents are lost.
+void reserveDumpBuff(size_t needed)
+{
+    if (dumpBuff != NULL && needed <= dumpBuffLen) return;
+
+    free(dumpBuff);
+    dumpBuffLen = (needed > DUMP_BUFF_LEN) ? needed : DUMP_BUFF_LEN;
+    dumpBuff = (char*)malloc(dumpBuffLen);
+    if (dumpBuff == NULL)  // error check
+    {
+        fprintf(stderr, "Error: dump failed; could not allocate sufficient memory for output.\n");
+        exit(0);
+    }
+}
+
 void dump(APInt *arr, const size_t size, FILE *stream)
 {
+    reserveDumpBuff(DUMP_BUFF_LEN);
+
+    // stream every value through the buffer, writing it out only when full
+    size_t used = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        // "0x", the digits and a newline
+        size_t needed = APIntToHex(&arr[i], NULL, 0) + 3;
+        if (used + needed > dumpBuffLen)
+        {
+            fwrite(dumpBuff, 1, used, stream);
+            used = 0;
+        }
+        if (needed > dumpBuffLen) reserveDumpBuff(needed);
+
+        dumpBuff[used++] = '0';
+        dumpBuff[used++] = 'x';
+        used += APIntToHex(&arr[i], dumpBuff + used, dumpBuffLen - used);
+        dumpBuff[used++] = '\n';
+    }
+    fwrite(dumpBuff, 1, used, stream);
+    fprintf(stream, "\n");
+}
+
+// As `dump`, in decimal and without a prefix.
+void dumpDecimal(APInt *arr, const size_t size, FILE *stream)
+{
+    reserveDumpBuff(DUMP_BUFF_LEN);
+
+    size_t used = 0;
     for (size_t i = 0; i < size; i++)
     {
-        APIntPrintAsHex(&arr[i], stream);
+        // the most digits the value can have and a newline
+        size_t needed = APIntToDecimal(&arr[i], NULL, 0) + 1;
+        if (used + needed > dumpBuffLen)
+        {
+            fwrite(dumpBuff, 1, used, stream);
+            used = 0;
+        }
+        if (needed > dumpBuffLen) reserveDumpBuff(needed);
+
+        used += APIntToDecimal(&arr[i], dumpBuff + used, dumpBuffLen - used);
+        dumpBuff[used++] = '\n';
     }
+    fwrite(dumpBuff, 1, used, stream);
     fprintf(stream, "\n");
 }
 
+// BINARY SNAPSHOTS
+// A snapshot file starts with a 24-byte header: the magic "APINTARR", the format version
+// and the number of values, each a little endian u_int64_t after the magic. A table of
+// one u_int64_t file offset per value follows, then the values in the library's binary
+// form (APIntSerialize) at those offsets, which are multiples of 8.
+#define SNAPSHOT_MAGIC "APINTARR"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER 24
+
+// mapping the values of a loaded snapshot point into; unmapped by `cleanup`
+static void *snapshotMap = NULL;
+static size_t snapshotMapLen = 0;
+
+// command file being run, NULL for stdin; relative snapshot paths start from its directory
+static const char *commandFile = NULL;
+
+// Snapshot `path` as named in the command file, relative paths taken from the directory
+// of that file so it finds its snapshots from any working directory, followed by
+// `suffix`. Returns a malloc'd string, or NULL if out of memory.
+char *snapshotPath(const char *path, const char *suffix)
+{
+    const char *slash = (commandFile == NULL || path[0] == '/') ? NULL : strrchr(commandFile, '/');
+    size_t dirLen = (slash == NULL) ? 0 : (size_t)(slash - commandFile) + 1;
+    size_t pathLen = strlen(path), suffixLen = strlen(suffix);
+    char *full = (char*)malloc(dirLen + pathLen + suffixLen + 1);
+    if (full == NULL) return NULL;
+    if (dirLen > 0) memcpy(full, commandFile, dirLen);
+    memcpy(full + dirLen, path, pathLen);
+    memcpy(full + dirLen + pathLen, suffix, suffixLen + 1);
+    return full;
+}
+
+u_int64_t loadLE64(const unsigned char *p)
+{
+    u_int64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+void storeLE64(unsigned char *p, u_int64_t value)
+{
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(value >> (8 * i));
+}
+
+// Write the values of arr[0, size) to a snapshot file at `path` (see snapshotPath). The
+// file is written under a temporary name in the same directory and then renamed over
+// `path`, since loaded values may still borrow their limbs from a mapping of that file.
+void dumpSnapshot(APInt *arr, const size_t size, const char *path)
+{
+    char *target = snapshotPath(path, "");
+    char *tempPath = snapshotPath(path, ".XXXXXX");
+    if (target == NULL || tempPath == NULL)  // error check
+    {
+        fprintf(stderr, "Error: dump failed; could not allocate sufficient memory.\n");
+        exit(0);
+    }
+    int fd = mkstemp(tempPath);
+    FILE *file = (fd < 0) ? NULL : fdopen(fd, "wb");
+    if (file == NULL)  // error check
+    {
+        fprintf(stderr, "Error: dump failed; could not open snapshot file.\n");
+        if (fd >= 0)
+        {
+            close(fd);
+            unlink(tempPath);
+        }
+        free(tempPath);
+        free(target);
+        exit(0);
+    }
+
+    unsigned char word[8];
+    fwrite(SNAPSHOT_MAGIC, 1, 8, file);
+    storeLE64(word, SNAPSHOT_VERSION);
+    fwrite(word, 1, 8, file);
+    storeLE64(word, size);
+    fwrite(word, 1, 8, file);
+
+    // every binary form is a whole number of u_int64_t, so offsets stay aligned
+    u_int64_t offset = SNAPSHOT_HEADER + 8 * (u_int64_t)size;
+    for (size_t i = 0; i < size; i++)
+    {
+        storeLE64(word, offset);
+        fwrite(word, 1, 8, file);
+        offset += APIntSerialize(&arr[i], NULL, 0);
+    }
+
+    for (size_t i = 0; i < size; i++)
+    {
+        size_t length = APIntSerialize(&arr[i], NULL, 0);
+        reserveDumpBuff(length);
+        APIntSerialize(&arr[i], dumpBuff, length);
+        fwrite(dumpBuff, 1, length, file);
+    }
+
+    if (fclose(file) != 0)  // error check
+    {
+        fprintf(stderr, "Error: dump failed; could not write snapshot file.\n");
+        unlink(tempPath);
+        free(tempPath);
+        free(target);
+        exit(0);
+    }
+
+    // mkstemp creates the file 0600; give it the permissions a plain fopen would
+    mode_t mask = umask(0);
+    umask(mask);
+    chmod(tempPath, 0666 & ~mask);
+    if (rename(tempPath, target) != 0)  // error check
+    {
+        fprintf(stderr, "Error: dump failed; could not replace snapshot file.\n");
+        unlink(tempPath);
+        free(tempPath);
+        free(target);
+        exit(0);
+    }
+    free(tempPath);
+    free(target);
+}
+
+// Map the snapshot at `path` (see snapshotPath) and fill in a new array from it; on
+// little endian hosts the values use the mapped limbs in place. Returns the array and
+// sets *size, or returns NULL if the file cannot be read or is malformed.
+APInt *loadSnapshot(const char *path, u_int64_t *size)
+{
+    char *full = snapshotPath(path, "");
+    if (full == NULL) return NULL;
+    int fd = open(full, O_RDONLY);
+    free(full);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < SNAPSHOT_HEADER)
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    // the header, table and every value have to lie within the file
+    const unsigned char *base = (const unsigned char*)map;
+    u_int64_t count = loadLE64(base + 16);
+    APInt *arr = NULL;
+    if (memcmp(base, SNAPSHOT_MAGIC, 8) != 0 || loadLE64(base + 8) != SNAPSHOT_VERSION ||
+        count == 0 || count >= 10000 || count > (len - SNAPSHOT_HEADER) / 8)
+        goto malformed;
+
+    arr = (APInt*)calloc(count, sizeof(APInt));
+    if (arr == NULL) goto malformed;
+    for (u_int64_t i = 0; i < count; i++)
+    {
+        u_int64_t offset = loadLE64(base + SNAPSHOT_HEADER + 8 * i);
+        if (offset % 8 != 0 || offset > len - 8) goto malformed;
+        u_int64_t limbs = loadLE64(base + offset);
+        if (limbs > (len - offset - 8) / 8) goto malformed;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        APIntDeserialize(base + offset, len - offset, &arr[i]);
+#else
+        APIntWrapLimbs((const u_int64_t*)(base + offset + 8), (size_t)limbs, &arr[i]);
+#endif
+    }
+
+    snapshotMap = map;
+    snapshotMapLen = len;
+    *size = count;
+    return arr;
+
+malformed:
+    // values taken so far own nothing, or own copies on big endian hosts
+    if (arr != NULL)
+    {
+        for (u_int64_t i = 0; i < count; i++)
+        {
+            if (arr[i].limbs != NULL) APIntDestroy(&arr[i]);
+        }
+    }
+    free(arr);
+    munmap(map, len);
+    return NULL;
+}
+
+// INPUT
+// The command file is mapped and parsed where it lies; input that cannot be mapped
+// (stdin, pipes) is read in large blocks into a buffer instead. Lines are handed out as
+// a pointer and a length, without the newline, and stay valid until the next line is
+// read. Nothing is copied on the way to the parsers.
+typedef struct Input {
+    FILE *stream;
+    char *data;         // the mapped file, or the read buffer
+    size_t len;         // bytes of data available
+    size_t pos;         // start of the next line
+    size_t cap;         // size of the read buffer; 0 when the file is mapped
+    int eof;            // the stream has nothing more to read
+} Input;
+
+// input lines read so far, so statistics can point at a command
+static size_t inputLine = 0;
+
+void inputOpen(Input *in, FILE *stream)
+{
+    memset(in, 0, sizeof(Input));
+    in->stream = stream;
+
+    // regular files are mapped whole; anything else falls back to reading
+    struct stat st;
+    int fd = fileno(stream);
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+            in->data = (char*)map;
+            in->len = (size_t)st.st_size;
+            in->eof = 1;
+            return;
+        }
+    }
+
+    in->cap = INPUT_BLOCK;
+    in->data = (char*)malloc(in->cap);
+    if (in->data == NULL)  // error check
+    {
+        fprintf(stderr, "Error: main failed; could not allocate sufficient memory for user input.\n");
+        exit(0);
+    }
+}
+
+void inputClose(Input *in)
+{
+    if (in->cap == 0)
+    {
+        if (in->data != NULL) munmap(in->data, in->len);
+    }
+    else
+    {
+        free(in->data);
+    }
+    in->data = NULL;
+}
+
+// Set *line and *lineLen to the next line; returns 0 if input ran out.
+int readLine(Input *in, const char **line, size_t *lineLen)
+{
+    for (;;)
+    {
+        char *start = in->data + in->pos;
+        char *newline = (char*)memchr(start, '\n', in->len - in->pos);
+        if (newline != NULL)
+        {
+            *line = start;
+            *lineLen = (size_t)(newline - start);
+            in->pos += *lineLen + 1;
+            inputLine++;
+            return 1;
+        }
+        if (in->eof)
+        {
+            // a last line without a newline still counts
+            if (in->pos == in->len) return 0;
+            *line = start;
+            *lineLen = in->len - in->pos;
+            in->pos = in->len;
+            inputLine++;
+            return 1;
+        }
+
+        // keep the partial line, moved to the front, and read more behind it; a line
+        // longer than the buffer doubles it
+        size_t partial = in->len - in->pos;
+        memmove(in->data, start, partial);
+        in->len = partial;
+        in->pos = 0;
+        if (in->len == in->cap)
+        {
+            char *grown = (char*)realloc(in->data, 2 * in->cap);
+            if (grown == NULL)  // error check
+            {
+                fprintf(stderr, "Error: main failed; could not allocate sufficient memory for user input.\n");
+                exit(0);
+            }
+            in->data = grown;
+            in->cap *= 2;
+        }
+        size_t got = fread(in->data + in->len, 1, in->cap - in->len, in->stream);
+        if (got == 0) in->eof = 1;
+        in->len += got;
+    }
+}
+
+// Parse the decimal number at *p, skipping spaces before it, and move *p past it; like
+// strtoull, a missing number is zero.
+u_int64_t parseNumber(const char **p, const char *end)
+{
+    const char *c = *p;
+    while (c < end && *c == ' ') c++;
+
+    u_int64_t value = 0;
+    while (c < end && (unsigned)(*c - '0') < 10)
+    {
+        value = 10 * value + (u_int64_t)(*c - '0');
+        c++;
+    }
+    *p = c;
+    return value;
+}
+
+// A NUL-terminated copy of text[0, len), for the file APIs; NULL if out of memory.
+char *copyText(const char *text, size_t len)
+{
+    char *copy = (char*)malloc(len + 1);
+    if (copy == NULL) return NULL;
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+// MODULAR CONTEXTS
+// A Montgomery context costs a few modular products to build, so each thread keeps the
+// last one it built, with a copy of its modulus, for as long as the modulus recurs.
+static __thread APIntModContext modContext;
+static __thread APInt modContextModulus;
+static __thread int modContextSet = 0;
+
+void modContextRelease(void)
+{
+    if (!modContextSet) return;
+    APIntModDestroy(&modContext);
+    APIntDestroy(&modContextModulus);
+    modContextSet = 0;
+}
+
+// Context for `modulus`, or NULL if it is even or zero.
+const APIntModContext *modContextFor(const APInt *modulus)
+{
+    if (modContextSet && APIntCompare(&modContextModulus, modulus) == 0) return &modContext;
+
+    modContextRelease();
+    if (!APIntModInit(modulus, &modContext)) return NULL;
+    APIntClone(modulus, &modContextModulus);
+    modContextSet = 1;
+    return &modContext;
+}
+
+// COMMANDS
+typedef enum CommandType {
+    CMD_DUMP,
+    CMD_DUMP_BINARY,
+    CMD_DUMP_DECIMAL,
+    CMD_END,
+    CMD_SHL,
+    CMD_ADD,
+    CMD_MUL_UINT64,
+    CMD_MUL_APINT,
+    CMD_POW,
+    CMD_CMP,
+    CMD_MOD_MUL,
+    CMD_MOD_POW,
+    CMD_DIV,
+    CMD_MOD,
+    CMD_ADD_MUL,        // fused by the peephole pass, never read from input
+    CMD_ADD_MUL_UINT64,
+    CMD_ADD_SHL,
+    CMD_INVALID
+} CommandType;
+
+// one parsed operation; indices it does not use are left at zero
+typedef struct Command {
+    CommandType type;
+    u_int64_t dst;      // index written (every operation but CMP); also read by ADD_*
+    u_int64_t op1;      // first operand index
+    u_int64_t op2;      // second operand index (ADD, MUL_APINT, CMP, MOD_MUL, DIV, MOD), or exponent
+                        // (MOD_POW)
+    u_int64_t mod;      // modulus index (MOD_MUL, MOD_POW)
+    u_int64_t k;        // shift, factor or exponent
+    int result;         // outcome of CMP; nonzero when a MOD_* modulus is even or zero, or a DIV
+                        // or MOD divisor is zero
+    size_t line;        // input line of the command name
+    const char *path;   // DUMP_BINARY file, in the input until the next line is read
+    size_t pathLen;
+    size_t waiting;     // earlier commands of the window it must wait for
+    int started;
+} Command;
+
+// Which command `name` is; the length and first letter narrow it to one candidate.
+CommandType commandType(const char *name, size_t len)
+{
+#define COMMAND_IS(text) (len == sizeof(text) - 1 && memcmp(name, text, len) == 0)
+    if (len == 0) return CMD_INVALID;
+    switch (name[0])
+    {
+    case 'A': return COMMAND_IS("ADD") ? CMD_ADD : CMD_INVALID;
+    case 'C': return COMMAND_IS("CMP") ? CMD_CMP : CMD_INVALID;
+    case 'E': return COMMAND_IS("END") ? CMD_END : CMD_INVALID;
+    case 'P': return COMMAND_IS("POW") ? CMD_POW : CMD_INVALID;
+    case 'S': return COMMAND_IS("SHL") ? CMD_SHL : CMD_INVALID;
+    case 'D':
+        if (COMMAND_IS("DIV")) return CMD_DIV;
+        if (COMMAND_IS("DUMP")) return CMD_DUMP;
+        if (COMMAND_IS("DUMP_BINARY")) return CMD_DUMP_BINARY;
+        return COMMAND_IS("DUMP_DECIMAL") ? CMD_DUMP_DECIMAL : CMD_INVALID;
+    case 'M':
+        if (COMMAND_IS("MUL_APINT")) return CMD_MUL_APINT;
+        if (COMMAND_IS("MUL_UINT64")) return CMD_MUL_UINT64;
+        if (COMMAND_IS("MOD")) return CMD_MOD;
+        if (COMMAND_IS("MOD_MUL")) return CMD_MOD_MUL;
+        return COMMAND_IS("MOD_POW") ? CMD_MOD_POW : CMD_INVALID;
+    default: return CMD_INVALID;
+    }
+#undef COMMAND_IS
+}
+
+// whether a command reads a second APInt operand
+int commandHasOp2(CommandType type)
+{
+    return type == CMD_ADD || type == CMD_MUL_APINT || type == CMD_CMP || type == CMD_MOD_MUL ||
+           type == CMD_MOD_POW || type == CMD_DIV || type == CMD_MOD || type == CMD_ADD_MUL;
+}
+
+// Read the next command and its argument line into `cmd`; returns 0 if input ran out.
+int readCommand(Input *in, Command *cmd)
+{
+    const char *line;
+    size_t lineLen;
+    memset(cmd, 0, sizeof(Command));
+    if (!readLine(in, &line, &lineLen)) return 0;
+    cmd->line = inputLine;
+    cmd->type = commandType(line, lineLen);
+
+    if (cmd->type == CMD_DUMP || cmd->type == CMD_DUMP_DECIMAL || cmd->type == CMD_END ||
+        cmd->type == CMD_INVALID)
+        return 1;
+
+    if (!readLine(in, &line, &lineLen)) return 0;
+    if (cmd->type == CMD_DUMP_BINARY)
+    {
+        cmd->path = line;
+        cmd->pathLen = lineLen;
+        if (lineLen == 0) cmd->type = CMD_INVALID;
+        return 1;
+    }
+    const char *end = line + lineLen;
+
+    // proper input assumed: "op1 op2" for CMP, "dst op1 op2 mod" for MOD_MUL,
+    // "dst base exp mod" for MOD_POW, "dst op1 op2" or "dst src k" otherwise
+    if (cmd->type != CMD_CMP) cmd->dst = parseNumber(&line, end);
+    cmd->op1 = parseNumber(&line, end);
+    if (commandHasOp2(cmd->type))
+        cmd->op2 = parseNumber(&line, end);
+    else
+        cmd->k = parseNumber(&line, end);
+    if (cmd->type == CMD_MOD_MUL || cmd->type == CMD_MOD_POW) cmd->mod = parseNumber(&line, end);
+    return 1;
+}
+
+// Run an operation; results go straight into dst, which may also be an operand.
+void executeCommand(Command *cmd, APInt *arr)
+{
+    switch (cmd->type)
+    {
+    case CMD_SHL:
+        APIntShiftLeft(&arr[cmd->op1], cmd->k, &arr[cmd->dst]);
+        break;
+    case CMD_ADD:
+        APIntAdd(&arr[cmd->op1], &arr[cmd->op2], &arr[cmd->dst]);
+        break;
+    case CMD_MUL_UINT64:
+        APInt64Mult(&arr[cmd->op1], cmd->k, &arr[cmd->dst]);
+        break;
+    case CMD_MUL_APINT:
+        APIntMult(&arr[cmd->op1], &arr[cmd->op2], &arr[cmd->dst]);
+        break;
+    case CMD_POW:
+        APIntPow(&arr[cmd->op1], cmd->k, &arr[cmd->dst]);
+        break;
+    case CMD_CMP:
+        cmd->result = APIntCompare(&arr[cmd->op1], &arr[cmd->op2]);
+        break;
+    case CMD_MOD_MUL:
+    case CMD_MOD_POW:
+    {
+        // Montgomery reduction takes odd moduli only; the window reports the rest
+        const APIntModContext *ctx = modContextFor(&arr[cmd->mod]);
+        cmd->result = (ctx == NULL);
+        if (ctx == NULL) break;
+        if (cmd->type == CMD_MOD_MUL)
+            APIntModMul(&arr[cmd->op1], &arr[cmd->op2], ctx, &arr[cmd->dst]);
+        else
+            APIntModPow(&arr[cmd->op1], &arr[cmd->op2], ctx, &arr[cmd->dst]);
+        break;
+    }
+    case CMD_DIV:
+    case CMD_MOD:
+    {
+        // a zero divisor is reported by the window like an unusable modulus
+        const APInt *divisor = &arr[cmd->op2];
+        cmd->result = (divisor->size == 1 && divisor->limbs[0] == 0);
+        if (cmd->result) break;
+        if (cmd->type == CMD_DIV)
+            APIntDivMod(&arr[cmd->op1], divisor, &arr[cmd->dst], NULL);
+        else
+            APIntDivMod(&arr[cmd->op1], divisor, NULL, &arr[cmd->dst]);
+        break;
+    }
+    case CMD_ADD_MUL:
+        APIntAddMul(&arr[cmd->dst], &arr[cmd->op1], &arr[cmd->op2]);
+        break;
+    case CMD_ADD_MUL_UINT64:
+        APIntAddMul64(&arr[cmd->dst], &arr[cmd->op1], cmd->k);
+        break;
+    case CMD_ADD_SHL:
+        APIntAddShifted(&arr[cmd->dst], &arr[cmd->op1], cmd->k);
+        break;
+    default:
+        break;
+    }
+}
+
+// STATISTICS
+// Opt-in per command type: APINT_STATS=1 prints a table to stderr at END, and
+// APINT_STATS_JSON=<path> writes the same numbers as JSON: an object with "unit",
+// "pool_allocs_counted" and "commands", which maps each command name that ran to its
+// "count", "total_ns", "max_ns", "max_line", "operand_limbs", "max_operand_limbs",
+// "result_limbs", "max_result_limbs", "allocs" and "alloc_bytes". When neither is set,
+// the allocator hook stays the C library's and commands run untimed.
+// Allocations are counted on the thread that runs the command. Those that the thread
+// pool (APINT_THREADS) makes for an NTT product are not counted at all, which the table
+// notes when the pool is on and the JSON states as "pool_allocs_counted": false.
+typedef struct CommandStats {
+    u_int64_t count;
+    u_int64_t totalNs;
+    u_int64_t maxNs;
+    size_t maxLine;             // input line of the slowest command
+    u_int64_t operandLimbs;     // summed over every operand read
+    size_t maxOperandLimbs;
+    u_int64_t resultLimbs;
+    size_t maxResultLimbs;
+    u_int64_t allocs;           // library allocations and reallocations
+    u_int64_t allocBytes;
+} CommandStats;
+
+static const char *commandNames[CMD_INVALID] = {
+    "DUMP", "DUMP_BINARY", "DUMP_DECIMAL", "END", "SHL", "ADD", "MUL_UINT64", "MUL_APINT", "POW", "CMP",
+    "MOD_MUL", "MOD_POW", "DIV", "MOD", "ADD_MUL", "ADD_MUL_UINT64", "ADD_SHL"
+};
+
+static int statsEnabled = 0;
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+static CommandStats stats[CMD_INVALID];
+
+// allocations the library made on this thread; commands read the change around them
+static __thread u_int64_t threadAllocs = 0;
+static __thread u_int64_t threadAllocBytes = 0;
+
+void *countingAlloc(size_t size)
+{
+    threadAllocs++;
+    threadAllocBytes += size;
+    return malloc(size);
+}
+
+void *countingRealloc(void *ptr, size_t oldSize, size_t newSize)
+{
+    (void)oldSize;
+    threadAllocs++;
+    threadAllocBytes += newSize;
+    return realloc(ptr, newSize);
+}
+
+void countingFree(void *ptr, size_t size)
+{
+    (void)size;
+    free(ptr);
+}
+
+u_int64_t statsNowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_int64_t)ts.tv_sec * 1000000000ull + (u_int64_t)ts.tv_nsec;
+}
+
+// Add one command's measurements to the totals of its type.
+void statsRecord(CommandType type, size_t line, u_int64_t ns, u_int64_t operandLimbs, size_t maxOperand,
+                 size_t resultLimbs, u_int64_t allocs, u_int64_t allocBytes)
+{
+    pthread_mutex_lock(&statsLock);
+    CommandStats *entry = &stats[type];
+    entry->count++;
+    entry->totalNs += ns;
+    if (ns >= entry->maxNs)
+    {
+        entry->maxNs = ns;
+        entry->maxLine = line;
+    }
+    entry->operandLimbs += operandLimbs;
+    if (maxOperand > entry->maxOperandLimbs) entry->maxOperandLimbs = maxOperand;
+    entry->resultLimbs += resultLimbs;
+    if (resultLimbs > entry->maxResultLimbs) entry->maxResultLimbs = resultLimbs;
+    entry->allocs += allocs;
+    entry->allocBytes += allocBytes;
+    pthread_mutex_unlock(&statsLock);
+}
+
+void statsPrint(FILE *stream)
+{
+    fprintf(stream, "%-14s %10s %12s %12s %9s %14s %14s %10s %14s\n", "command", "count", "total_ms",
+            "max_ms", "max_line", "max_operand", "max_result", "allocs", "alloc_bytes");
+    for (int t = 0; t < CMD_INVALID; t++)
+    {
+        const CommandStats *entry = &stats[t];
+        if (entry->count == 0) continue;
+        fprintf(stream, "%-14s %10llu %12.3f %12.3f %9zu %14zu %14zu %10llu %14llu\n", commandNames[t],
+                (unsigned long long)entry->count, entry->totalNs / 1e6, entry->maxNs / 1e6, entry->maxLine,
+                entry->maxOperandLimbs, entry->maxResultLimbs, (unsigned long long)entry->allocs,
+                (unsigned long long)entry->allocBytes);
+    }
+    if (APIntGetThreads() > 1)
+        fprintf(stream, "allocs and alloc_bytes leave out the allocations of the thread pool\n");
+}
+
+void statsWriteJSON(FILE *stream)
+{
+    fprintf(stream, "{\n  \"unit\": {\"time\": \"ns\", \"size\": \"limbs\"},\n  \"pool_allocs_counted\": false,\n"
+            "  \"commands\": {");
+    int first = 1;
+    for (int t = 0; t < CMD_INVALID; t++)
+    {
+        const CommandStats *entry = &stats[t];
+        if (entry->count == 0) continue;
+        fprintf(stream, "%s\n    \"%s\": {\"count\": %llu, \"total_ns\": %llu, \"max_ns\": %llu, "
+                "\"max_line\": %zu, \"operand_limbs\": %llu, \"max_operand_limbs\": %zu, "
+                "\"result_limbs\": %llu, \"max_result_limbs\": %zu, \"allocs\": %llu, \"alloc_bytes\": %llu}",
+                first ? "" : ",", commandNames[t], (unsigned long long)entry->count,
+                (unsigned long long)entry->totalNs, (unsigned long long)entry->maxNs, entry->maxLine,
+                (unsigned long long)entry->operandLimbs, entry->maxOperandLimbs,
+                (unsigned long long)entry->resultLimbs, entry->maxResultLimbs,
+                (unsigned long long)entry->allocs, (unsigned long long)entry->allocBytes);
+        first = 0;
+    }
+    fprintf(stream, "\n  }\n}\n");
+}
+
+// Run an operation, measuring it when statistics are on.
+void runCommand(Command *cmd, APInt *arr)
+{
+    if (!statsEnabled)
+    {
+        executeCommand(cmd, arr);
+        return;
+    }
+
+    // operands are sized before dst, which may be one of them, is overwritten
+    size_t size1 = arr[cmd->op1].size, size2 = commandHasOp2(cmd->type) ? arr[cmd->op2].size : 0;
+    u_int64_t allocs = threadAllocs, allocBytes = threadAllocBytes;
+
+    u_int64_t start = statsNowNs();
+    executeCommand(cmd, arr);
+    u_int64_t ns = statsNowNs() - start;
+
+    size_t result = (cmd->type == CMD_CMP) ? 0 : arr[cmd->dst].size;
+    statsRecord(cmd->type, cmd->line, ns, size1 + size2, (size1 > size2) ? size1 : size2, result,
+                threadAllocs - allocs, threadAllocBytes - allocBytes);
+}
+
+int commandReads(const Command *cmd, u_int64_t i)
+{
+    int modular = (cmd->type == CMD_MOD_MUL || cmd->type == CMD_MOD_POW);
+    int accumulates = (cmd->type == CMD_ADD_MUL || cmd->type == CMD_ADD_MUL_UINT64 || cmd->type == CMD_ADD_SHL);
+    return cmd->op1 == i || (commandHasOp2(cmd->type) && cmd->op2 == i) || (modular && cmd->mod == i) ||
+           (accumulates && cmd->dst == i);
+}
+
+// whether `later` has to wait for `earlier`: one of them writes what the other touches
+int commandConflicts(const Command *earlier, const Command *later)
+{
+    if (earlier->type != CMD_CMP &&
+        (commandReads(later, earlier->dst) || (later->type != CMD_CMP && later->dst == earlier->dst)))
+        return 1;
+    return later->type != CMD_CMP && commandReads(earlier, later->dst);
+}
+
+
+// COMMAND SCHEDULER
+// Worker threads and the main thread run a window of commands together, each command
+// as soon as every earlier one it conflicts with has finished.
+static pthread_mutex_t schedLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t schedWake = PTHREAD_COND_INITIALIZER;    // window posted or a command done
+static Command *schedCmds = NULL;
+static size_t schedCount = 0;
+static size_t schedDone = 0;
+static APInt *schedArr = NULL;
+static int schedStop = 0;
+static pthread_t *schedWorkers = NULL;
+static size_t schedWorkerCount = 0;
+
+// Run one ready command of the window, if any; called and returns with schedLock held.
+int scheduleStep(void)
+{
+    for (size_t i = 0; i < schedCount; i++)
+    {
+        Command *cmd = &schedCmds[i];
+        if (cmd->started || cmd->waiting > 0) continue;
+
+        cmd->started = 1;
+        pthread_mutex_unlock(&schedLock);
+        runCommand(cmd, schedArr);
+        pthread_mutex_lock(&schedLock);
+
+        schedDone++;
+        for (size_t j = i + 1; j < schedCount; j++)
+        {
+            if (commandConflicts(cmd, &schedCmds[j])) schedCmds[j].waiting--;
+        }
+        pthread_cond_broadcast(&schedWake);
+        return 1;
+    }
+    return 0;
+}
+
+void *scheduleWorker(void *unused)
+{
+    (void)unused;
+    pthread_mutex_lock(&schedLock);
+    while (!schedStop)
+    {
+        if (!scheduleStep()) pthread_cond_wait(&schedWake, &schedLock);
+    }
+    pthread_mutex_unlock(&schedLock);
+
+    // the library's scratch memory and the modular context of this thread die with it
+    modContextRelease();
+    APIntReleaseScratch();
+    return NULL;
+}
+
+// Start `jobs` - 1 workers; the main thread is the last job.
+void scheduleStart(size_t jobs)
+{
+    if (jobs < 2) return;
+    schedWorkers = (pthread_t*)malloc((jobs - 1) * sizeof(pthread_t));
+    if (schedWorkers == NULL)  // error check
+    {
+        fprintf(stderr, "Error: main failed; could not allocate sufficient memory for the scheduler.\n");
+        exit(0);
+    }
+
+    // a worker that cannot be started only costs parallelism
+    while (schedWorkerCount + 1 < jobs &&
+           pthread_create(&schedWorkers[schedWorkerCount], NULL, scheduleWorker, NULL) == 0)
+    {
+        schedWorkerCount++;
+    }
+}
+
+void scheduleStopWorkers(void)
+{
+    pthread_mutex_lock(&schedLock);
+    schedStop = 1;
+    pthread_cond_broadcast(&schedWake);
+    pthread_mutex_unlock(&schedLock);
+
+    for (size_t i = 0; i < schedWorkerCount; i++) pthread_join(schedWorkers[i], NULL);
+    free(schedWorkers);
+    schedWorkers = NULL;
+    schedWorkerCount = 0;
+}
+
+// Run cmds[0, count) with the same results as running them in order.
+void scheduleRun(Command *cmds, size_t count, APInt *arr)
+{
+    if (schedWorkerCount == 0 || count < 2)
+    {
+        for (size_t i = 0; i < count; i++) runCommand(&cmds[i], arr);
+        return;
+    }
+
+    for (size_t j = 0; j < count; j++)
+    {
+        for (size_t i = 0; i < j; i++)
+        {
+            if (commandConflicts(&cmds[i], &cmds[j])) cmds[j].waiting++;
+        }
+    }
+
+    pthread_mutex_lock(&schedLock);
+    schedCmds = cmds;
+    schedCount = count;
+    schedDone = 0;
+    schedArr = arr;
+    pthread_cond_broadcast(&schedWake);
+    while (schedDone < schedCount)
+    {
+        if (!scheduleStep()) pthread_cond_wait(&schedWake, &schedLock);
+    }
+    schedCount = 0;
+    pthread_mutex_unlock(&schedLock);
+}
+
+// PEEPHOLE PASS
+// Opt-in with APINT_PEEPHOLE=1: a MUL_APINT, MUL_UINT64 or SHL into a temporary that the
+// next command adds into an accumulator, and nothing reads afterwards, runs as one fused
+// command that never builds the temporary.
+static int peepholeEnabled = 0;
+
+// Whether cmds[from, count) read slot t before overwriting it; `readAfter` says whether
+// the values are read once the window is over (by a DUMP).
+int peepholeLive(const Command *cmds, size_t from, size_t count, u_int64_t t, int readAfter)
+{
+    for (size_t i = from; i < count; i++)
+    {
+        if (commandReads(&cmds[i], t)) return 1;
+        if (cmds[i].type != CMD_CMP && cmds[i].dst == t) return 0;
+    }
+    return readAfter;
+}
+
+// Fused form of `cmd` when `next` is `ADD d d t` or `ADD d t d` for cmd's dst t, d != t;
+// CMD_INVALID if there is none.
+CommandType peepholeFused(const Command *cmd, const Command *next)
+{
+    u_int64_t t = cmd->dst, d = next->dst;
+    if (next->type != CMD_ADD || d == t) return CMD_INVALID;
+    if (!((next->op1 == d && next->op2 == t) || (next->op1 == t && next->op2 == d))) return CMD_INVALID;
+
+    switch (cmd->type)
+    {
+    case CMD_MUL_APINT: return CMD_ADD_MUL;
+    case CMD_MUL_UINT64: return CMD_ADD_MUL_UINT64;
+    case CMD_SHL: return CMD_ADD_SHL;
+    default: return CMD_INVALID;
+    }
+}
+
+// Fuse the pairs of cmds[0, count) in place, keeping the first command's operands and
+// line; returns the new count.
+size_t peepholeWindow(Command *cmds, size_t count, int readAfter)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        Command cmd = cmds[i];
+        CommandType fused = (i + 1 < count) ? peepholeFused(&cmds[i], &cmds[i + 1]) : CMD_INVALID;
+        if (fused != CMD_INVALID && !peepholeLive(cmds, i + 2, count, cmds[i].dst, readAfter))
+        {
+            cmd.type = fused;
+            cmd.dst = cmds[i + 1].dst;
+            i++;
+        }
+        cmds[kept++] = cmd;
+    }
+    return kept;
+}
+
+// Print the CMP results of a window that has run, in order; returns the first command
+// that could not run (an unusable modulus or a zero divisor), before anything after it
+// is printed, or NULL.
+const Command *reportWindow(const Command *cmds, size_t count, FILE *output)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (cmds[i].type == CMD_CMP)
+            fprintf(output, "%d\n", cmds[i].result);
+        else if (cmds[i].result)
+            return &cmds[i];
+    }
+    return NULL;
+}
+
 void cleanup(APInt *arr, size_t size)
 {
     // free heap data from each APInt
@@ -24,6 +969,16 @@ void cleanup(APInt *arr, size_t size)
     }
     // free array from heap
     free(arr);
+    // values loaded from a snapshot may have pointed into its mapping
+    if (snapshotMap != NULL) munmap(snapshotMap, snapshotMapLen);
+    snapshotMap = NULL;
+    // free DUMP output buffer
+    free(dumpBuff);
+    dumpBuff = NULL;
+    // join the worker threads, if any, and drop this thread's modular context
+    scheduleStopWorkers();
+    modContextRelease();
+    APIntSetThreads(1);
 }
 
 int main(int argc, char const *argv[]) {
@@ -42,298 +997,249 @@ int main(int argc, char const *argv[]) {
     input = stdin;
     else
     input = fopen(argv[1], "r");
+    if (inputGiven) commandFile = argv[1];
+
+    // statistics are opt-in: APINT_STATS=1 for a table on stderr, APINT_STATS_JSON=<path>
+    // for a JSON file; counting allocations needs the hook in place before any APInt exists
+    const char *statsText = getenv("APINT_STATS");
+    const char *statsJSON = getenv("APINT_STATS_JSON");
+    if ((statsText != NULL && strcmp(statsText, "0") != 0) || statsJSON != NULL)
+    {
+        statsEnabled = 1;
+        APIntSetAllocator(countingAlloc, countingRealloc, countingFree);
+    }
+
+    // parallel multiplication is opt-in: APINT_THREADS=<count>
+    const char *threads = getenv("APINT_THREADS");
+    if (threads != NULL) APIntSetThreads((size_t)strtoull(threads, NULL, 10));
+
+    // so is running independent commands side by side: APINT_JOBS=<count>
+    const char *jobs = getenv("APINT_JOBS");
+    if (jobs != NULL) scheduleStart((size_t)strtoull(jobs, NULL, 10));
+
+    // and fusing adjacent commands: APINT_PEEPHOLE=1
+    const char *peephole = getenv("APINT_PEEPHOLE");
+    peepholeEnabled = (peephole != NULL && strcmp(peephole, "0") != 0);
 
     /* Your code to init APInt array, and operate on them here. */
 
-    size_t buffLen = MAX_LEN;
-    char *buffer = (char*)malloc(buffLen);
-    if (buffer == NULL)  // error check
+    if (input == NULL)  // error check
     {
-        fprintf(stderr, "Error: main failed; could not allocate sufficient memory for user input.\n");
+        fprintf(stderr, "Error: main failed; could not open input file.\n");
         exit(0);
     }
+    Input in;
+    inputOpen(&in, input);
 
-    ssize_t ret = getline(&buffer, &buffLen, input);
-    if (ret == -1)
+    const char *line;
+    size_t lineLen;
+    if (!readLine(&in, &line, &lineLen))
     {
         fprintf(stderr, "Error: main failed; could not collect command line.\n");
-        free(buffer);
+        inputClose(&in);
         exit(0);
     }
-    char *command = strtok(buffer, "\n");    // isolate monocommand (remove '\n')
 
-    u_int64_t arrSize = strtoull(command, NULL, 10);
-    if (arrSize == 0 || arrSize >= 10000)   // invalid command
+    // "LOAD" and a snapshot path stand in for the count and the creation commands
+    int loaded = (lineLen == 4 && memcmp(line, "LOAD", 4) == 0);
+    u_int64_t arrSize = 0;
+    APInt *apint_arr = NULL;
+    if (loaded)
     {
-        free(buffer);
-        exit(0);
+        char *path = NULL;
+        if (readLine(&in, &line, &lineLen) && lineLen > 0) path = copyText(line, lineLen);
+        if (path != NULL) apint_arr = loadSnapshot(path, &arrSize);
+        free(path);
+        if (apint_arr == NULL)  // error check
+        {
+            fprintf(stderr, "Error: main failed; could not load snapshot.\n");
+            inputClose(&in);
+            exit(0);
+        }
     }
-
-    APInt *apint_arr = (APInt*)calloc(arrSize, sizeof(APInt));
-    if (apint_arr == NULL)  // error check
+    else
     {
-        fprintf(stderr, "Error: main failed; could not allocate sufficient memory for APInts.\n");
-        free(buffer);
-        exit(0);
+        arrSize = parseNumber(&line, line + lineLen);
+        if (arrSize == 0 || arrSize >= 10000)   // invalid command
+        {
+            inputClose(&in);
+            exit(0);
+        }
+
+        apint_arr = (APInt*)calloc(arrSize, sizeof(APInt));
+        if (apint_arr == NULL)  // error check
+        {
+            fprintf(stderr, "Error: main failed; could not allocate sufficient memory for APInts.\n");
+            inputClose(&in);
+            exit(0);
+        }
     }
 
-    // Creation of APInt array
-    for (u_int64_t i = 0; i < arrSize; i++)
+    // Creation of APInt array, unless a snapshot supplied it
+    for (u_int64_t i = 0; i < arrSize && !loaded; i++)
     {
-        ret = getline(&buffer, &buffLen, input);
-        if (ret == -1)
+        // each creation command is a name line and an argument line
+        const char *command;
+        size_t commandLen;
+        int gotCommand = readLine(&in, &command, &commandLen);
+        int isUint64 = gotCommand && commandLen == 6 && memcmp(command, "UINT64", 6) == 0;
+        int isHex = gotCommand && commandLen == 10 && memcmp(command, "HEX_STRING", 10) == 0;
+        int isDec = gotCommand && commandLen == 10 && memcmp(command, "DEC_STRING", 10) == 0;
+        int isClone = gotCommand && commandLen == 5 && memcmp(command, "CLONE", 5) == 0;
+        if (gotCommand && !isUint64 && !isHex && !isDec && !isClone)    // invalid command
+        {
+            // cleanup program and exit
+            inputClose(&in);
+            if (i == 0)
+                free(apint_arr);
+            else
+                cleanup(apint_arr, i);
+            exit(0);
+        }
+        if (!gotCommand || !readLine(&in, &line, &lineLen))
         {
             fprintf(stderr, "Error: main failed; could not collect command line.\n");
-            free(buffer);
+            inputClose(&in);
             if (i == 0)
                 free(apint_arr);
             else
                 cleanup(apint_arr, i);
             exit(0);
         }
-        command = strtok(buffer, "\n");
 
-        if (!strcmp(command, "UINT64"))
+        if (isUint64)
         {
-            ret = getline(&buffer, &buffLen, input);
-            if (ret == -1)
-            {
-                fprintf(stderr, "Error: main failed; could not collect command line.\n");
-                free(buffer);
-                if (i == 0)
-                    free(apint_arr);
-                else
-                    cleanup(apint_arr, i);
-                exit(0);
-            }
-            command = strtok(buffer, "\n");
-
-            uint64_t int64 = strtoull(command, NULL, 10);
+            uint64_t int64 = parseNumber(&line, line + lineLen);
             APIntConvertFrom64(int64, &apint_arr[i]);
         }
-        else if (!strcmp(command, "HEX_STRING"))
+        else if (isHex)
         {
-            ret = getline(&buffer, &buffLen, input);
-            if (ret == -1)
-            {
-                fprintf(stderr, "Error: main failed; could not collect command line.\n");
-                free(buffer);
-                if (i == 0)
-                    free(apint_arr);
-                else
-                    cleanup(apint_arr, i);
-                exit(0);
-            }
-            command = strtok(buffer, "\n");
-
-            APIntHexToAPInt(command, &apint_arr[i]);
+            // the digits are decoded straight out of the input
+            APIntHexToAPIntN(line, lineLen, &apint_arr[i]);
         }
-        else if (!strcmp(command, "CLONE"))
+        else if (isDec)
         {
-            ret = getline(&buffer, &buffLen, input);
-            if (ret == -1)
-            {
-                fprintf(stderr, "Error: main failed; could not collect command line.\n");
-                free(buffer);
-                if (i == 0)
-                    free(apint_arr);
-                else
-                    cleanup(apint_arr, i);
-                exit(0);
-            }
-            command = strtok(buffer, "\n");
-            u_int64_t k = strtoull(command, NULL, 10);
-
-            APIntClone(&apint_arr[k], &apint_arr[i]);
+            APIntFromDecimal(line, lineLen, &apint_arr[i]);
         }
-        else    // invalid command
+        else
         {
-            // cleanup program and exit
-            free(buffer);
-            if (i == 0)
-                free(apint_arr);
-            else
-                cleanup(apint_arr, i);
-            exit(0);
+            u_int64_t k = parseNumber(&line, line + lineLen);
+            APIntClone(&apint_arr[k], &apint_arr[i]);
         }
     }
 
-    // Operations on APInts within APInt array
+    // Operations on APInts within APInt array. Commands are read a window at a time, up to
+    // a DUMP or END; the window runs (fused by the peephole pass when it is on, in parallel
+    // when the scheduler has workers) and its CMP results are printed in order before the
+    // DUMP, so output matches running each command as it is read.
+    Command window[SCHEDULE_WINDOW];
+    size_t windowSize = (schedWorkerCount > 0 || peepholeEnabled) ? SCHEDULE_WINDOW : 1;
     int running = 1;
     while (running)
     {
-        ret = getline(&buffer, &buffLen, input);
-        if (ret == -1)
+        size_t count = 0;
+        Command last;
+        int haveLast = 0;
+        while (count < windowSize)
         {
-            fprintf(stderr, "Error: main failed; could not collect command line.\n");
-            free(buffer);
-            cleanup(apint_arr, arrSize);
-            exit(0);
-        }
-        command = strtok(buffer, "\n");
-
-        if (!strcmp(command, "DUMP"))
-        {
-            dump(apint_arr, arrSize, output);   // print all APInts
-        }
-        else if (!strcmp(command, "END"))
-        {
-            running = 0;                        // for program exit
-        }
-        else if (!strcmp(command, "SHL"))
-        {
-            ret = getline(&buffer, &buffLen, input);
-            if (ret == -1)
+            if (!readCommand(&in, &window[count]))
             {
+                // finish what was read so its output is not lost
+                scheduleRun(window, count, apint_arr);
+                reportWindow(window, count, output);
                 fprintf(stderr, "Error: main failed; could not collect command line.\n");
-                free(buffer);
+                inputClose(&in);
                 cleanup(apint_arr, arrSize);
                 exit(0);
             }
-            char *rest = buffer;
 
-            // proper input assumed ("dst src k")
-            u_int64_t dst = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-            u_int64_t src = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-            u_int64_t k = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-
-            APInt srcCpy;
-            APIntClone(&apint_arr[src], &srcCpy);
-            for (u_int64_t i = 0; i < k; i++)
+            CommandType type = window[count].type;
+            if (type == CMD_DUMP || type == CMD_DUMP_BINARY || type == CMD_DUMP_DECIMAL || type == CMD_END ||
+                type == CMD_INVALID)
             {
-                APIntLShift(&srcCpy);
+                last = window[count];
+                haveLast = 1;
+                break;
             }
-            
-            free(apint_arr[dst].bytes);
-            APIntClone(&srcCpy, &apint_arr[dst]);
-            APIntDestroy(&srcCpy);
+            count++;
         }
-        else if (!strcmp(command, "ADD"))
-        {
-            ret = getline(&buffer, &buffLen, input);
-            if (ret == -1)
-            {
-                fprintf(stderr, "Error: main failed; could not collect command line.\n");
-                free(buffer);
-                cleanup(apint_arr, arrSize);
-                exit(0);
-            }
-            char *rest = buffer;
-
-            // proper input assumed ("dst op1 op2")
-            u_int64_t dst = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-            u_int64_t op1 = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-            u_int64_t op2 = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-
-            APInt sum;
-            APIntAdd(&apint_arr[op1], &apint_arr[op2], &sum);
 
-            free(apint_arr[dst].bytes);
-            APIntClone(&sum, &apint_arr[dst]);
-            APIntDestroy(&sum);
+        // a run ending here reads nothing more, so its temporaries are all dead
+        if (peepholeEnabled)
+        {
+            int readAfter = !haveLast || (last.type != CMD_END && last.type != CMD_INVALID);
+            count = peepholeWindow(window, count, readAfter);
         }
-        else if (!strcmp(command, "MUL_UINT64"))
+        scheduleRun(window, count, apint_arr);
+        const Command *failed = reportWindow(window, count, output);
+        if (failed != NULL)
         {
-            ret = getline(&buffer, &buffLen, input);
-            if (ret == -1)
-            {
-                fprintf(stderr, "Error: main failed; could not collect command line.\n");
-                free(buffer);
-                cleanup(apint_arr, arrSize);
-                exit(0);
-            }
-            char *rest = buffer;
-
-            // proper input assumed ("dst src k")
-            u_int64_t dst = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-            u_int64_t src = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-            u_int64_t k = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-
-            APInt product;
-            APInt64Mult(&apint_arr[src], k, &product);
-            
-            free(apint_arr[dst].bytes);
-            APIntClone(&product, &apint_arr[dst]);
-            APIntDestroy(&product);
+            if (failed->type == CMD_DIV || failed->type == CMD_MOD)
+                fprintf(stderr, "Error: main failed; division by zero.\n");
+            else
+                fprintf(stderr, "Error: main failed; modulus must be odd.\n");
+            inputClose(&in);
+            cleanup(apint_arr, arrSize);
+            exit(0);
         }
-        else if (!strcmp(command, "MUL_APINT"))
+        if (!haveLast) continue;
+
+        if (last.type == CMD_DUMP)
         {
-            ret = getline(&buffer, &buffLen, input);
-            if (ret == -1)
-            {
-                fprintf(stderr, "Error: main failed; could not collect command line.\n");
-                free(buffer);
-                cleanup(apint_arr, arrSize);
-                exit(0);
-            }
-            char *rest = buffer;
-
-            // proper input assumed ("dst op1 op2")
-            u_int64_t dst = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-            u_int64_t op1 = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-            u_int64_t op2 = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-
-            APInt product;
-            APIntMult(&apint_arr[op1], &apint_arr[op2], &product);
-            
-            free(apint_arr[dst].bytes);
-            APIntClone(&product, &apint_arr[dst]);
-            APIntDestroy(&product);
+            u_int64_t start = statsEnabled ? statsNowNs() : 0;
+            dump(apint_arr, arrSize, output);   // print all APInts
+            if (statsEnabled) statsRecord(CMD_DUMP, last.line, statsNowNs() - start, 0, 0, 0, 0, 0);
+        }
+        else if (last.type == CMD_DUMP_DECIMAL)
+        {
+            u_int64_t start = statsEnabled ? statsNowNs() : 0;
+            dumpDecimal(apint_arr, arrSize, output);
+            if (statsEnabled) statsRecord(CMD_DUMP_DECIMAL, last.line, statsNowNs() - start, 0, 0, 0, 0, 0);
         }
-        else if (!strcmp(command, "POW"))
+        else if (last.type == CMD_DUMP_BINARY)
         {
-            ret = getline(&buffer, &buffLen, input);
-            if (ret == -1)
+            u_int64_t start = statsEnabled ? statsNowNs() : 0;
+            char *path = copyText(last.path, last.pathLen);
+            if (path == NULL)  // error check
             {
-                fprintf(stderr, "Error: main failed; could not collect command line.\n");
-                free(buffer);
+                fprintf(stderr, "Error: main failed; could not allocate sufficient memory for user input.\n");
+                inputClose(&in);
                 cleanup(apint_arr, arrSize);
                 exit(0);
             }
-            char *rest = buffer;
-
-            // proper input assumed ("dst src k")
-            u_int64_t dst = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-            u_int64_t src = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-            u_int64_t k = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-
-            APInt power;
-            APIntPow(&apint_arr[src], k, &power);
-            
-            free(apint_arr[dst].bytes);
-            APIntClone(&power, &apint_arr[dst]);
-            APIntDestroy(&power);
+            dumpSnapshot(apint_arr, arrSize, path);
+            free(path);
+            if (statsEnabled) statsRecord(CMD_DUMP_BINARY, last.line, statsNowNs() - start, 0, 0, 0, 0, 0);
         }
-        else if (!strcmp(command, "CMP"))
+        else if (last.type == CMD_END)
         {
-            ret = getline(&buffer, &buffLen, input);
-            if (ret == -1)
+            running = 0;                        // for program exit
+            if (statsText != NULL && strcmp(statsText, "0") != 0) statsPrint(stderr);
+            if (statsJSON != NULL)
             {
-                fprintf(stderr, "Error: main failed; could not collect command line.\n");
-                free(buffer);
-                cleanup(apint_arr, arrSize);
-                exit(0);
+                FILE *json = fopen(statsJSON, "w");
+                if (json == NULL)  // error check
+                {
+                    fprintf(stderr, "Error: main failed; could not open statistics file.\n");
+                }
+                else
+                {
+                    statsWriteJSON(json);
+                    fclose(json);
+                }
             }
-            char *rest = buffer;
-
-            // proper input assumed ("op1 op2")
-            u_int64_t op1 = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-            u_int64_t op2 = strtoull(strtok_r(rest, " ", &rest), NULL, 10);
-
-            int result = APIntCompare(&apint_arr[op1], &apint_arr[op2]);
-            fprintf(output, "%d\n", result);
         }
         else    // invalid command
         {
             // cleanup program and exit
-            free(buffer);
+            inputClose(&in);
             cleanup(apint_arr, arrSize);
             exit(0);
         }
     }
 
     // cleanup user input
-    free(buffer);
+    inputClose(&in);
     // clean up memory space
     cleanup(apint_arr, arrSize);
 